@@ -0,0 +1,249 @@
+/**
+ * @file CCalibratedView.h
+ * @brief Defines a C++20 ranges view that corrects nominal values lazily.
+ *
+ * Writing `Samples | calibrated(CalibrationMap)` yields the corrected points one at a
+ * time as the range is consumed, so it fuses with other range adaptors without
+ * materialising intermediate vectors.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <version>
+
+#if defined(__cpp_lib_ranges)
+#include <ranges>
+#include <iterator>
+
+/**
+ * @class CCalibratedView
+ * @brief Lazily maps a range of nominal values to corrected points.
+ *
+ * Each iterator carries its own search cursor and looks values up with
+ * CCalibrationMap::ErrorValueAt(), so when the map is frozen, sorted or slowly
+ * varying input is corrected at batch-kernel speed and random input falls back to a
+ * binary search. Values are computed on every dereference; nothing is cached.
+ * @tparam V The underlying view of values convertible to double.
+ */
+template <std::ranges::input_range V>
+  requires std::ranges::view<V> && std::convertible_to<std::ranges::range_reference_t<V>, double>
+class CCalibratedView : public std::ranges::view_interface<CCalibratedView<V>>
+{
+public:
+  CCalibratedView() = default;
+
+  /**
+   * @brief Creates a view correcting Nominals with Map.
+   * @param Nominals The range of nominal values.
+   * @param Map The calibration map. It must outlive the view.
+   */
+  CCalibratedView(V Nominals, CCalibrationMap& Map)
+    : m_Base(std::move(Nominals)), m_Map(&Map)
+  {
+  }
+
+  auto begin()
+  {
+    return Iterator<false>(std::ranges::begin(m_Base), m_Map);
+  }
+
+  auto begin() const
+    requires std::ranges::input_range<const V>
+  {
+    return Iterator<true>(std::ranges::begin(m_Base), m_Map);
+  }
+
+  auto end()
+  {
+    if constexpr (std::ranges::common_range<V>)
+      return Iterator<false>(std::ranges::end(m_Base), m_Map);
+    else
+      return Sentinel<false>(std::ranges::end(m_Base));
+  }
+
+  auto end() const
+    requires std::ranges::input_range<const V>
+  {
+    if constexpr (std::ranges::common_range<const V>)
+      return Iterator<true>(std::ranges::end(m_Base), m_Map);
+    else
+      return Sentinel<true>(std::ranges::end(m_Base));
+  }
+
+  auto size()
+    requires std::ranges::sized_range<V>
+  {
+    return std::ranges::size(m_Base);
+  }
+
+  auto size() const
+    requires std::ranges::sized_range<const V>
+  {
+    return std::ranges::size(m_Base);
+  }
+
+  /**
+   * @brief Gets the underlying range.
+   * @return The range of nominal values.
+   */
+  V base() const&
+    requires std::copy_constructible<V>
+  {
+    return m_Base;
+  }
+
+private:
+  template <bool Const>
+  using Base = std::conditional_t<Const, const V, V>;
+
+  /**
+   * @brief Iterator producing corrected points.
+   */
+  template <bool Const>
+  class Iterator
+  {
+  public:
+    using value_type = double;
+    using difference_type = std::ranges::range_difference_t<Base<Const>>;
+    using iterator_concept = std::conditional_t<std::ranges::forward_range<Base<Const>>,
+      std::forward_iterator_tag, std::input_iterator_tag>;
+
+    Iterator() = default;
+
+    Iterator(std::ranges::iterator_t<Base<Const>> Current, CCalibrationMap* Map)
+      : m_Current(std::move(Current)), m_Map(Map)
+    {
+    }
+
+    /**
+     * @brief Corrects the current nominal value.
+     * @return The corrected point.
+     * @throws std::runtime_error if the map is empty.
+     * @throws std::out_of_range if the nominal value is outside the map range.
+     */
+    double operator*() const
+    {
+      double Nominal = *m_Current;
+      return Nominal - m_Map->ErrorValueAt(Nominal, m_Cursor);
+    }
+
+    Iterator& operator++()
+    {
+      ++m_Current;
+      return *this;
+    }
+
+    void operator++(int)
+    {
+      ++*this;
+    }
+
+    Iterator operator++(int)
+      requires std::ranges::forward_range<Base<Const>>
+    {
+      Iterator Previous = *this;
+      ++*this;
+      return Previous;
+    }
+
+    friend bool operator==(const Iterator& Left, const Iterator& Right)
+      requires std::equality_comparable<std::ranges::iterator_t<Base<Const>>>
+    {
+      return Left.m_Current == Right.m_Current;
+    }
+
+    const std::ranges::iterator_t<Base<Const>>& base() const&
+    {
+      return m_Current;
+    }
+
+  private:
+    /**
+     * @brief Position in the underlying range.
+     */
+    std::ranges::iterator_t<Base<Const>> m_Current = std::ranges::iterator_t<Base<Const>>();
+
+    /**
+     * @brief The calibration map used for correction.
+     */
+    CCalibrationMap* m_Map = nullptr;
+
+    /**
+     * @brief Segment hint carried between consecutive lookups.
+     */
+    mutable size_t m_Cursor = 0;
+  };
+
+  /**
+   * @brief End marker for underlying ranges whose end is not an iterator.
+   */
+  template <bool Const>
+  class Sentinel
+  {
+  public:
+    Sentinel() = default;
+
+    explicit Sentinel(std::ranges::sentinel_t<Base<Const>> End)
+      : m_End(std::move(End))
+    {
+    }
+
+    friend bool operator==(const Iterator<Const>& Left, const Sentinel& Right)
+    {
+      return Left.base() == Right.m_End;
+    }
+
+  private:
+    std::ranges::sentinel_t<Base<Const>> m_End = std::ranges::sentinel_t<Base<Const>>();
+  };
+
+  /**
+   * @brief The range of nominal values.
+   */
+  V m_Base = V();
+
+  /**
+   * @brief The calibration map used for correction.
+   */
+  CCalibrationMap* m_Map = nullptr;
+};
+
+template <typename R>
+CCalibratedView(R&&, CCalibrationMap&) -> CCalibratedView<std::views::all_t<R>>;
+
+/**
+ * @class CCalibratedAdaptor
+ * @brief Range adaptor closure created by calibrated().
+ */
+class CCalibratedAdaptor
+{
+public:
+  explicit CCalibratedAdaptor(CCalibrationMap& Map)
+    : m_Map(&Map)
+  {
+  }
+
+  template <std::ranges::viewable_range R>
+  friend auto operator|(R&& Range, const CCalibratedAdaptor& Adaptor)
+  {
+    return CCalibratedView(std::views::all(std::forward<R>(Range)), *Adaptor.m_Map);
+  }
+
+private:
+  /**
+   * @brief The calibration map used for correction.
+   */
+  CCalibrationMap* m_Map;
+};
+
+/**
+ * @brief Creates a range adaptor that corrects nominal values with a calibration map.
+ * @param Map The calibration map. It must outlive every view created from the adaptor.
+ * @return An adaptor for use as `Range | calibrated(Map)`.
+ */
+inline CCalibratedAdaptor calibrated(CCalibrationMap& Map)
+{
+  return CCalibratedAdaptor(Map);
+}
+
+#endif
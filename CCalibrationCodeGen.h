@@ -0,0 +1,190 @@
+/**
+ * @file CCalibrationCodeGen.h
+ * @brief Defines the CCalibrationCodeGen class, which emits specialised C++ for a fixed map.
+ *
+ * Firmware targets with a known calibration table do not need a tree or a generic
+ * search. The generator writes a self-contained header holding the table as
+ * constants and a lookup function specialised for it: index arithmetic when the
+ * breakpoints are uniformly spaced, an unrolled balanced comparison tree for small
+ * tables and a branch-free binary search otherwise. The interpolation expression is
+ * the one CCalibrationMap uses, so results match ErrorValue() bit for bit.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <ostream>
+#include <string>
+
+/**
+ * @class CCalibrationCodeGen
+ * @brief Generates a lookup header for a calibration map.
+ */
+class CCalibrationCodeGen
+{
+public:
+  /**
+   * @brief Options controlling the generated code.
+   */
+  struct Options
+  {
+    std::string Name = "CGeneratedCalibration";  ///< Name of the generated struct.
+    bool UseExceptions = true;                   ///< Throw like CCalibrationMap, or return NaN when false.
+    size_t MaxUnrolled = 64;                     ///< Largest table searched with an unrolled comparison tree.
+  };
+
+  /**
+   * @brief Writes the generated header.
+   * @param Out The stream receiving the header.
+   * @param Map The calibration map to specialise for.
+   * @param Settings Generation options.
+   * @throws std::runtime_error if the map is empty.
+   */
+  static void Generate(std::ostream& Out, CCalibrationMap& Map, const Options& Settings)
+  {
+    const std::map<double, double>& Source = Map.GetMap();
+    if (Source.empty())
+      throw std::runtime_error("Calibration map is empty.");
+
+    std::vector<double> Nominals;
+    std::vector<double> Errors;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+    {
+      Nominals.push_back(it->first);
+      Errors.push_back(it->second);
+    }
+    size_t Count = Nominals.size();
+
+    Out << "// Generated by CCalibrationCodeGen from a " << Count << "-point calibration map. Do not edit.\n\n";
+    Out << "#pragma once\n";
+    Out << "#include <cstddef>\n";
+    Out << (Settings.UseExceptions ? "#include <stdexcept>\n" : "#include <limits>\n");
+    Out << "\n";
+    Out << "struct " << Settings.Name << "\n{\n";
+    Out << "  static const size_t Count = " << Count << ";\n\n";
+    Out << "  static double ErrorValue(double Nominal)\n  {\n";
+    if (Count > 1)
+    {
+      Out << "    static constexpr double Nominals[" << Count << "] = {";
+      WriteArray(Out, Nominals);
+      Out << "};\n";
+    }
+    Out << "    static constexpr double Errors[" << Count << "] = {";
+    WriteArray(Out, Errors);
+    Out << "};\n\n";
+
+    Out << "    if (!(Nominal >= " << Literal(Nominals.front()) << " && Nominal <= " << Literal(Nominals.back()) << "))\n";
+    Out << (Settings.UseExceptions
+      ? "      throw std::out_of_range(\"Nominal value outside of calibrated range.\");\n"
+      : "      return std::numeric_limits<double>::quiet_NaN();\n");
+
+    if (Count == 1)
+    {
+      Out << "    return Errors[0];\n";
+    }
+    else
+    {
+      Out << "\n    size_t Index;\n";
+      double Step;
+      if (Count == 2)
+      {
+        Out << "    Index = 0;\n";
+      }
+      else if (IsUniform(Nominals, Step))
+      {
+        Out << "    Index = static_cast<size_t>((Nominal - " << Literal(Nominals.front()) << ") / " << Literal(Step) << ");\n";
+        Out << "    if (Index > " << Count - 2 << ")\n      Index = " << Count - 2 << ";\n";
+        Out << "    if (Nominal < Nominals[Index])\n      --Index;\n";
+        Out << "    else if (Index < " << Count - 2 << " && Nominal >= Nominals[Index + 1])\n      ++Index;\n";
+      }
+      else if (Count - 1 <= Settings.MaxUnrolled)
+      {
+        WriteTree(Out, Nominals, 0, Count - 2, 2);
+      }
+      else
+      {
+        Out << "    const double* Base = Nominals;\n";
+        Out << "    for (size_t Length = " << Count - 1 << "; Length > 1;)\n    {\n";
+        Out << "      size_t Half = Length / 2;\n";
+        Out << "      Base = Base[Half] <= Nominal ? Base + Half : Base;\n";
+        Out << "      Length -= Half;\n    }\n";
+        Out << "    Index = static_cast<size_t>(Base - Nominals);\n";
+      }
+
+      Out << "\n    if (Nominal == Nominals[Index])\n      return Errors[Index];\n";
+      Out << "    if (Nominal == Nominals[Index + 1])\n      return Errors[Index + 1];\n";
+      Out << "    return Errors[Index] + (Nominal - Nominals[Index]) * (Errors[Index + 1] - Errors[Index])"
+        " / (Nominals[Index + 1] - Nominals[Index]);\n";
+    }
+
+    Out << "  }\n\n";
+    Out << "  static double CorrectedPoint(double Nominal)\n  {\n";
+    Out << "    return Nominal - ErrorValue(Nominal);\n  }\n";
+    Out << "};\n";
+  }
+
+private:
+  /**
+   * @brief Formats a double so that it reads back exactly.
+   * @param Value The value.
+   * @return The literal.
+   */
+  static std::string Literal(double Value)
+  {
+    std::ostringstream Text;
+    Text.precision(17);
+    Text << Value;
+    std::string Result = Text.str();
+    if (Result.find_first_of(".eE") == std::string::npos)
+      Result += ".0";
+    return Result;
+  }
+
+  static void WriteArray(std::ostream& Out, const std::vector<double>& Values)
+  {
+    for (size_t i = 0; i < Values.size(); ++i)
+      Out << (i % 4 == 0 ? "\n      " : " ") << Literal(Values[i]) << (i + 1 < Values.size() ? "," : "");
+    Out << "\n    ";
+  }
+
+  /**
+   * @brief Checks whether every breakpoint equals First + i * Step exactly.
+   * @param Nominals Sorted breakpoints, at least two.
+   * @param Step Receives the spacing.
+   * @return True if the breakpoints are uniformly spaced.
+   */
+  static bool IsUniform(const std::vector<double>& Nominals, double& Step)
+  {
+    Step = (Nominals.back() - Nominals.front()) / (Nominals.size() - 1);
+    if (!(Step > 0.0))
+      return false;
+    for (size_t i = 0; i < Nominals.size(); ++i)
+      if (Nominals.front() + i * Step != Nominals[i])
+        return false;
+    return true;
+  }
+
+  /**
+   * @brief Writes a balanced comparison tree selecting a segment.
+   * @param Out The stream receiving the code.
+   * @param Nominals Sorted breakpoints.
+   * @param First First candidate segment.
+   * @param Last Last candidate segment.
+   * @param Depth Indentation depth.
+   */
+  static void WriteTree(std::ostream& Out, const std::vector<double>& Nominals, size_t First, size_t Last, size_t Depth)
+  {
+    std::string Indent(2 * Depth, ' ');
+    if (First == Last)
+    {
+      Out << Indent << "Index = " << First << ";\n";
+      return;
+    }
+
+    size_t Middle = (First + Last + 1) / 2;
+    Out << Indent << "if (Nominal < " << Literal(Nominals[Middle]) << ")\n" << Indent << "{\n";
+    WriteTree(Out, Nominals, First, Middle - 1, Depth + 1);
+    Out << Indent << "}\n" << Indent << "else\n" << Indent << "{\n";
+    WriteTree(Out, Nominals, Middle, Last, Depth + 1);
+    Out << Indent << "}\n";
+  }
+};
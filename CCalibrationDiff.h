@@ -0,0 +1,130 @@
+/**
+ * @file CCalibrationDiff.h
+ * @brief Defines the CCalibrationDiff structure, a structural diff between two calibration maps.
+ *
+ * Reviewing a new calibration by diffing GetMapSummary() text is slow and says
+ * nothing about how much corrections move between breakpoints. The diff merge-walks
+ * both maps once, in linear time, reporting added, removed and changed breakpoints
+ * and the largest change in interpolated correction over their common range.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+
+/**
+ * @struct CCalibrationDiff
+ * @brief Differences between an old and a new calibration map.
+ */
+struct CCalibrationDiff
+{
+  /**
+   * @brief A breakpoint present in both maps with different errors.
+   */
+  struct Change
+  {
+    double Nominal;   ///< The breakpoint.
+    double OldError;  ///< Error in the old map.
+    double NewError;  ///< Error in the new map.
+  };
+
+  std::vector<std::pair<double, double>> Added;    ///< Breakpoints and errors only in the new map.
+  std::vector<std::pair<double, double>> Removed;  ///< Breakpoints and errors only in the old map.
+  std::vector<Change> Changed;                     ///< Breakpoints whose error changed.
+
+  /**
+   * @brief Largest |new correction - old correction| over the range both maps cover.
+   *
+   * Both maps are piecewise linear, so the largest change occurs at a breakpoint of
+   * one of them and is found exactly. Zero if the ranges do not overlap.
+   */
+  double MaxCorrectionChange = 0.0;
+
+  /**
+   * @brief Nominal value where MaxCorrectionChange occurs.
+   */
+  double MaxChangeNominal = 0.0;
+
+  /**
+   * @brief Indicates whether the maps hold identical breakpoints.
+   * @return True if nothing was added, removed or changed.
+   */
+  bool IsEmpty() const
+  {
+    return Added.empty() && Removed.empty() && Changed.empty();
+  }
+
+  /**
+   * @brief Compares two calibration maps in one merge walk.
+   * @param Old The deployed map.
+   * @param New The candidate map.
+   * @return The differences.
+   */
+  static CCalibrationDiff Compute(CCalibrationMap& Old, CCalibrationMap& New)
+  {
+    const std::map<double, double>& OldMap = Old.GetMap();
+    const std::map<double, double>& NewMap = New.GetMap();
+    CCalibrationDiff Diff;
+
+    double RangeStart = 0.0;
+    double RangeEnd = -1.0;
+    if (!OldMap.empty() && !NewMap.empty())
+    {
+      RangeStart = std::max(OldMap.begin()->first, NewMap.begin()->first);
+      RangeEnd = std::min(std::prev(OldMap.end())->first, std::prev(NewMap.end())->first);
+    }
+
+    auto OldIt = OldMap.begin();
+    auto NewIt = NewMap.begin();
+    while (OldIt != OldMap.end() || NewIt != NewMap.end())
+    {
+      bool FromOld = NewIt == NewMap.end() || (OldIt != OldMap.end() && OldIt->first <= NewIt->first);
+      bool FromNew = OldIt == OldMap.end() || (NewIt != NewMap.end() && NewIt->first <= OldIt->first);
+      double Nominal = FromOld ? OldIt->first : NewIt->first;
+
+      if (Nominal >= RangeStart && Nominal <= RangeEnd)
+      {
+        double Delta = std::fabs(ValueAt(OldIt, Nominal) - ValueAt(NewIt, Nominal));
+        if (Delta > Diff.MaxCorrectionChange)
+        {
+          Diff.MaxCorrectionChange = Delta;
+          Diff.MaxChangeNominal = Nominal;
+        }
+      }
+
+      if (FromOld && FromNew)
+      {
+        if (OldIt->second != NewIt->second)
+          Diff.Changed.push_back(Change { Nominal, OldIt->second, NewIt->second });
+        ++OldIt;
+        ++NewIt;
+      }
+      else if (FromOld)
+      {
+        Diff.Removed.push_back(*OldIt);
+        ++OldIt;
+      }
+      else
+      {
+        Diff.Added.push_back(*NewIt);
+        ++NewIt;
+      }
+    }
+
+    return Diff;
+  }
+
+private:
+  /**
+   * @brief Evaluates a map at a nominal value during the merge walk.
+   * @param Next The first breakpoint not below Nominal; Nominal lies within the map's range.
+   * @param Nominal The nominal value.
+   * @return The error value, interpolated as CCalibrationMap does.
+   */
+  static double ValueAt(std::map<double, double>::const_iterator Next, double Nominal)
+  {
+    if (Next->first == Nominal)
+      return Next->second;
+    auto Previous = std::prev(Next);
+    return Previous->second + (Nominal - Previous->first) * (Next->second - Previous->second) / (Next->first - Previous->first);
+  }
+};
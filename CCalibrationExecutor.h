@@ -0,0 +1,303 @@
+/**
+ * @file CCalibrationExecutor.h
+ * @brief Defines the CCalibrationExecutor class, which corrects many buffers in parallel.
+ *
+ * Offline reprocessing applies maps of very different sizes to recordings of very
+ * different lengths, so splitting the work evenly up front leaves cores idle. Each
+ * worker here owns a deque of ranges. A worker splits the range it is about to
+ * process in half, keeping the front and pushing the back, for as long as the range
+ * is above the minimum grain and someone could use the other half. Idle workers
+ * steal the oldest, and so largest, range from another deque. Chunk sizes therefore
+ * adapt to the load: large while every worker is busy, fine-grained near the end.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+/**
+ * @class CCalibrationExecutor
+ * @brief Work-stealing executor for batch correction jobs.
+ *
+ * Maps are only read while jobs run. A map used by several jobs should be frozen
+ * beforehand and must not be modified until Run() returns.
+ */
+class CCalibrationExecutor
+{
+public:
+  /**
+   * @struct Job
+   * @brief Corrects one buffer with one map, as CCalibrationMap::CorrectedPoints() does.
+   */
+  struct Job
+  {
+    CCalibrationMap* Map;                 ///< Map applied to the buffer.
+    CStridedArray<const double> Nominals; ///< View of Count nominal values.
+    CStridedArray<double> Corrected;      ///< View receiving Count corrected points. It may alias Nominals.
+    size_t Count;                         ///< Number of values.
+  };
+
+  /**
+   * @brief Constructs an executor.
+   * @param Threads Number of worker threads, or zero for one per hardware thread.
+   * @param MinGrain Ranges at or below this many values are never split.
+   */
+  explicit CCalibrationExecutor(size_t Threads = 0, size_t MinGrain = 2048)
+    : m_Threads(Threads ? Threads : std::max(1u, std::thread::hardware_concurrency())),
+      m_MinGrain(std::max<size_t>(MinGrain, 1))
+  {
+  }
+
+  /**
+   * @brief Runs all jobs to completion.
+   *
+   * The calling thread works as one of the workers.
+   * @param Jobs The jobs to run.
+   * @throws std::runtime_error if a job's map is empty.
+   * @throws std::out_of_range if a nominal value is outside its map's range. Remaining work is abandoned and other outputs may be partially written.
+   * @throws std::system_error if a worker thread cannot be started. Outputs may be partially written.
+   */
+  void Run(const std::vector<Job>& Jobs)
+  {
+    m_Jobs = &Jobs;
+    m_Queues = std::vector<CQueue>(m_Threads);
+    m_Remaining = 0;
+    m_Idle = 0;
+    m_Failed = false;
+    m_Error = nullptr;
+
+    for (size_t i = 0; i < Jobs.size(); ++i)
+    {
+      if (Jobs[i].Count == 0)
+        continue;
+      m_Remaining += Jobs[i].Count;
+      m_Queues[i % m_Threads].Ranges.push_back(CRange{ i, 0, Jobs[i].Count });
+    }
+
+    std::vector<std::thread> Workers;
+    try
+    {
+      for (size_t Worker = 1; Worker < m_Threads; ++Worker)
+        Workers.emplace_back([this, Worker]() { Work(Worker); });
+    }
+    catch (...)
+    {
+      // Stop and join the workers already started before reporting the failure.
+      m_Failed = true;
+      for (size_t i = 0; i < Workers.size(); ++i)
+        Workers[i].join();
+      m_Jobs = nullptr;
+      throw;
+    }
+    Work(0);
+    for (size_t i = 0; i < Workers.size(); ++i)
+      Workers[i].join();
+
+    m_Jobs = nullptr;
+    if (m_Error)
+      std::rethrow_exception(m_Error);
+  }
+
+  /**
+   * @brief Gets the number of worker threads.
+   * @return The thread count, including the calling thread.
+   */
+  size_t GetThreadCount()
+  {
+    return m_Threads;
+  }
+
+private:
+  /**
+   * @struct CRange
+   * @brief Values [First, Last) of one job.
+   */
+  struct CRange
+  {
+    size_t Job;
+    size_t First;
+    size_t Last;
+  };
+
+  /**
+   * @struct CQueue
+   * @brief A worker's ranges. The owner works at the back, thieves take from the front.
+   */
+  struct CQueue
+  {
+    std::mutex Lock;
+    std::deque<CRange> Ranges;
+  };
+
+  /**
+   * @brief Number of workers, including the calling thread.
+   */
+  size_t m_Threads;
+
+  /**
+   * @brief Smallest range that is split.
+   */
+  size_t m_MinGrain;
+
+  /**
+   * @brief Jobs of the current run.
+   */
+  const std::vector<Job>* m_Jobs = nullptr;
+
+  /**
+   * @brief One queue per worker.
+   */
+  std::vector<CQueue> m_Queues;
+
+  /**
+   * @brief Values not yet corrected in the current run.
+   */
+  std::atomic<size_t> m_Remaining{ 0 };
+
+  /**
+   * @brief Workers that found their own queue empty and have not yet found work.
+   */
+  std::atomic<size_t> m_Idle{ 0 };
+
+  /**
+   * @brief Set once a job has thrown, so the others stop.
+   */
+  std::atomic<bool> m_Failed{ false };
+
+  /**
+   * @brief First exception thrown by a job.
+   */
+  std::exception_ptr m_Error;
+
+  /**
+   * @brief Guards m_Error.
+   */
+  std::mutex m_ErrorLock;
+
+  /**
+   * @brief Worker loop: run own ranges, steal when out of them, stop when all values are done.
+   * @param Self Index of this worker's queue.
+   */
+  void Work(size_t Self)
+  {
+    CRange Range;
+    bool Idle = false;
+    while (m_Remaining.load(std::memory_order_acquire) != 0 && !m_Failed.load(std::memory_order_relaxed))
+    {
+      if (!PopBack(Self, Range))
+      {
+        // Counted as idle until work is found, so busy workers keep splitting for it.
+        if (!Idle)
+          m_Idle.fetch_add(1, std::memory_order_relaxed);
+        Idle = true;
+        if (!Steal(Self, Range))
+        {
+          std::this_thread::yield();
+          continue;
+        }
+      }
+      if (Idle)
+        m_Idle.fetch_sub(1, std::memory_order_relaxed);
+      Idle = false;
+
+      try
+      {
+        Execute(Self, Range);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> Guard(m_ErrorLock);
+        if (!m_Error)
+          m_Error = std::current_exception();
+        m_Failed = true;
+      }
+    }
+    if (Idle)
+      m_Idle.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Corrects a range, first handing off its back half while it is large and others are idle or own queue is empty.
+   * @param Self Index of this worker's queue.
+   * @param Range The range to process.
+   */
+  void Execute(size_t Self, CRange Range)
+  {
+    while (Range.Last - Range.First > m_MinGrain && (m_Idle.load(std::memory_order_relaxed) != 0 || IsEmpty(Self)))
+    {
+      size_t Middle = Range.First + (Range.Last - Range.First) / 2;
+      PushBack(Self, CRange{ Range.Job, Middle, Range.Last });
+      Range.Last = Middle;
+    }
+
+    const Job& Target = (*m_Jobs)[Range.Job];
+    Target.Map->CorrectedPoints(Target.Nominals.Slice(Range.First), Target.Corrected.Slice(Range.First),
+      Range.Last - Range.First);
+    m_Remaining.fetch_sub(Range.Last - Range.First, std::memory_order_release);
+  }
+
+  /**
+   * @brief Takes a range from another worker's queue.
+   * @param Self Index of the stealing worker.
+   * @param Range Receives the stolen range.
+   * @return False if every other queue was empty.
+   */
+  bool Steal(size_t Self, CRange& Range)
+  {
+    bool Found = false;
+    for (size_t i = 1; i < m_Threads && !Found; ++i)
+    {
+      CQueue& Victim = m_Queues[(Self + i) % m_Threads];
+      std::lock_guard<std::mutex> Guard(Victim.Lock);
+      if (!Victim.Ranges.empty())
+      {
+        Range = Victim.Ranges.front();
+        Victim.Ranges.pop_front();
+        Found = true;
+      }
+    }
+    return Found;
+  }
+
+  /**
+   * @brief Takes the newest range from a worker's own queue.
+   * @param Self Index of the worker.
+   * @param Range Receives the range.
+   * @return False if the queue was empty.
+   */
+  bool PopBack(size_t Self, CRange& Range)
+  {
+    std::lock_guard<std::mutex> Guard(m_Queues[Self].Lock);
+    if (m_Queues[Self].Ranges.empty())
+      return false;
+    Range = m_Queues[Self].Ranges.back();
+    m_Queues[Self].Ranges.pop_back();
+    return true;
+  }
+
+  /**
+   * @brief Adds a range to a worker's own queue.
+   * @param Self Index of the worker.
+   * @param Range The range.
+   */
+  void PushBack(size_t Self, const CRange& Range)
+  {
+    std::lock_guard<std::mutex> Guard(m_Queues[Self].Lock);
+    m_Queues[Self].Ranges.push_back(Range);
+  }
+
+  /**
+   * @brief Checks whether a worker's own queue is empty.
+   * @param Self Index of the worker.
+   * @return True if the queue holds no ranges.
+   */
+  bool IsEmpty(size_t Self)
+  {
+    std::lock_guard<std::mutex> Guard(m_Queues[Self].Lock);
+    return m_Queues[Self].Ranges.empty();
+  }
+};
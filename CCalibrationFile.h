@@ -0,0 +1,289 @@
+/**
+ * @file CCalibrationFile.h
+ * @brief Defines the CCalibrationFile class for reading and writing calibration files.
+ *
+ * A calibration file is plain text with one point per line: the nominal value
+ * followed by the calibrated value, separated by whitespace or a comma. Blank
+ * lines and lines starting with '#' are ignored.
+ *
+ * The binary format is the magic "CMAP", a 32-bit version, a 64-bit point count,
+ * the points as (nominal, error) pairs of native doubles and a CRC-32 of the pairs.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+/**
+ * @class CCalibrationFile
+ * @brief Parses calibration files into CCalibrationMap objects.
+ */
+class CCalibrationFile
+{
+public:
+  /**
+   * @brief Parses calibration text and adds its points to a map.
+   * @param Data The file contents.
+   * @param Size Number of bytes in Data.
+   * @param Map The map receiving the points.
+   * @throws std::invalid_argument if a line is malformed.
+   */
+  static void ParseText(const char* Data, size_t Size, CCalibrationMap& Map)
+  {
+    std::string Line;
+    size_t LineNumber = 0;
+    size_t Start = 0;
+    while (Start < Size)
+    {
+      size_t End = Start;
+      while (End < Size && Data[End] != '\n')
+        ++End;
+      Line.assign(Data + Start, End - Start);
+      Start = End + 1;
+      ++LineNumber;
+
+      double Nominal;
+      double Calibrated;
+      if (ParsePoint(Line, LineNumber, Nominal, Calibrated))
+        Map.AddPoint(Nominal, Calibrated);
+    }
+  }
+
+  /**
+   * @brief Parses one line of calibration text.
+   * @param Line The line, without its newline.
+   * @param LineNumber The line number, used in error messages.
+   * @param Nominal Receives the nominal value.
+   * @param Calibrated Receives the calibrated value.
+   * @return False if the line is blank or a comment.
+   * @throws std::invalid_argument if the line is malformed.
+   */
+  static bool ParsePoint(const std::string& Line, size_t LineNumber, double& Nominal, double& Calibrated)
+  {
+    size_t First = Line.find_first_not_of(" \t\r");
+    if (First == std::string::npos || Line[First] == '#')
+      return false;
+
+    const char* Text = Line.c_str() + First;
+    char* Next;
+    Nominal = std::strtod(Text, &Next);
+    bool Valid = Next != Text;
+
+    Text = Next;
+    while (*Text == ' ' || *Text == '\t' || *Text == ',')
+      ++Text;
+    Calibrated = std::strtod(Text, &Next);
+    Valid = Valid && Next != Text;
+
+    while (*Next == ' ' || *Next == '\t' || *Next == '\r')
+      ++Next;
+    if (!Valid || *Next != '\0')
+    {
+      std::ostringstream Message;
+      Message << "Malformed calibration point on line " << LineNumber << ".";
+      throw std::invalid_argument(Message.str());
+    }
+    return true;
+  }
+
+  /**
+   * @brief Reads a calibration file with a blocking read.
+   * @param Path The file to read.
+   * @return The calibration map.
+   * @throws std::runtime_error if the file cannot be read.
+   * @throws std::invalid_argument if a line is malformed.
+   */
+  static CCalibrationMap LoadText(const std::string& Path)
+  {
+    std::ifstream File(Path, std::ios::binary);
+    if (!File)
+      throw std::runtime_error("Unable to open calibration file " + Path + ".");
+
+    std::string Contents((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+    if (File.bad())
+      throw std::runtime_error("Unable to read calibration file " + Path + ".");
+
+    CCalibrationMap Map;
+    ParseText(Contents.data(), Contents.size(), Map);
+    return Map;
+  }
+
+  /**
+   * @brief Updates a CRC-32 (IEEE 802.3) with more data.
+   * @param Data The bytes to add.
+   * @param Size Number of bytes.
+   * @param Crc The CRC of the preceding bytes, or zero to start.
+   * @return The updated CRC.
+   */
+  static uint32_t Crc32(const void* Data, size_t Size, uint32_t Crc = 0)
+  {
+    static const CCrcTable Table;
+    const unsigned char* Bytes = static_cast<const unsigned char*>(Data);
+    Crc = ~Crc;
+    for (size_t i = 0; i < Size; ++i)
+      Crc = Table.Entries[(Crc ^ Bytes[i]) & 0xFF] ^ (Crc >> 8);
+    return ~Crc;
+  }
+
+  /**
+   * @brief Computes the checksum of a map's points, as stored in the binary format.
+   * @param Map The map.
+   * @return The CRC-32 of the (nominal, error) pairs in order.
+   */
+  static uint32_t MapChecksum(CCalibrationMap& Map)
+  {
+    const std::map<double, double>& Source = Map.GetMap();
+    uint32_t Crc = 0;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+    {
+      double Pair[2] = { it->first, it->second };
+      Crc = Crc32(Pair, sizeof(Pair), Crc);
+    }
+    return Crc;
+  }
+
+  /**
+   * @brief Writes a map in the binary format.
+   * @param Out The stream to write to.
+   * @param Map The map to write.
+   * @throws std::runtime_error if the stream fails.
+   */
+  static void WriteBinary(std::ostream& Out, CCalibrationMap& Map)
+  {
+    const std::map<double, double>& Source = Map.GetMap();
+    WriteHeader(Out, Source.size());
+
+    uint32_t Crc = 0;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+      Crc = WritePoint(Out, it->first, it->second, Crc);
+    WriteValue(Out, Crc);
+
+    if (!Out)
+      throw std::runtime_error("Unable to write calibration map.");
+  }
+
+  /**
+   * @brief Reads a map in the binary format.
+   * @param In The stream to read from.
+   * @return The calibration map.
+   * @throws std::runtime_error if the data is truncated, not in the binary format or fails its checksum.
+   */
+  static CCalibrationMap ReadBinary(std::istream& In)
+  {
+    char Magic[4];
+    uint32_t Version = 0;
+    uint64_t Count = 0;
+    In.read(Magic, sizeof(Magic));
+    ReadValue(In, Version);
+    ReadValue(In, Count);
+    if (!In || std::memcmp(Magic, BinaryMagic, sizeof(Magic)) != 0 || Version != BinaryVersion)
+      throw std::runtime_error("Not a binary calibration map.");
+
+    std::map<double, double> Points;
+    uint32_t Crc = 0;
+    for (uint64_t i = 0; i < Count; ++i)
+    {
+      double Pair[2];
+      In.read(reinterpret_cast<char*>(Pair), sizeof(Pair));
+      if (!In)
+        throw std::runtime_error("Binary calibration map is truncated.");
+      Crc = Crc32(Pair, sizeof(Pair), Crc);
+      Points.emplace_hint(Points.end(), Pair[0], Pair[1]);
+    }
+
+    uint32_t Expected = 0;
+    ReadValue(In, Expected);
+    if (!In)
+      throw std::runtime_error("Binary calibration map is truncated.");
+    if (Crc != Expected)
+      throw std::runtime_error("Binary calibration map failed its checksum.");
+
+    CCalibrationMap Map;
+    Map.SetMap(std::move(Points));
+    return Map;
+  }
+
+  /**
+   * @brief Magic bytes opening the binary format.
+   */
+  static constexpr char BinaryMagic[4] = { 'C', 'M', 'A', 'P' };
+
+  /**
+   * @brief Version of the binary format.
+   */
+  static constexpr uint32_t BinaryVersion = 1;
+
+  /**
+   * @brief Writes the binary format header.
+   * @param Out The stream to write to.
+   * @param Count Number of points that follow.
+   */
+  static void WriteHeader(std::ostream& Out, uint64_t Count)
+  {
+    Out.write(BinaryMagic, sizeof(BinaryMagic));
+    WriteValue(Out, BinaryVersion);
+    WriteValue(Out, Count);
+  }
+
+  /**
+   * @brief Writes one point of the binary format.
+   * @param Out The stream to write to.
+   * @param Nominal The nominal value.
+   * @param Error The error value.
+   * @param Crc The CRC of the preceding points.
+   * @return The CRC including this point.
+   */
+  static uint32_t WritePoint(std::ostream& Out, double Nominal, double Error, uint32_t Crc)
+  {
+    double Pair[2] = { Nominal, Error };
+    Out.write(reinterpret_cast<const char*>(Pair), sizeof(Pair));
+    return Crc32(Pair, sizeof(Pair), Crc);
+  }
+
+  /**
+   * @brief Writes a trivially copyable value in native byte order.
+   * @param Out The stream to write to.
+   * @param Value The value.
+   */
+  template <typename T>
+  static void WriteValue(std::ostream& Out, const T& Value)
+  {
+    Out.write(reinterpret_cast<const char*>(&Value), sizeof(Value));
+  }
+
+  /**
+   * @brief Reads a trivially copyable value in native byte order.
+   * @param In The stream to read from.
+   * @param Value Receives the value.
+   */
+  template <typename T>
+  static void ReadValue(std::istream& In, T& Value)
+  {
+    In.read(reinterpret_cast<char*>(&Value), sizeof(Value));
+  }
+
+private:
+  /**
+   * @brief Lookup table for the reflected CRC-32 polynomial.
+   */
+  struct CCrcTable
+  {
+    uint32_t Entries[256];
+
+    CCrcTable()
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t Value = i;
+        for (int Bit = 0; Bit < 8; ++Bit)
+          Value = (Value & 1) ? 0xEDB88320u ^ (Value >> 1) : Value >> 1;
+        Entries[i] = Value;
+      }
+    }
+  };
+};
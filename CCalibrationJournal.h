@@ -0,0 +1,366 @@
+/**
+ * @file CCalibrationJournal.h
+ * @brief Defines the CCalibrationJournal class for crash-safe persistence of map edits.
+ *
+ * Every edit is appended to a journal as a fixed-size, checksummed record, so a
+ * write costs O(edit) instead of rewriting the whole map. Periodic snapshots bound
+ * the journal length, and recovery loads the latest snapshot and replays only the
+ * records written after it. A torn record at the end of the journal, left by a
+ * crash mid-write, is detected by its checksum and discarded.
+ */
+
+#pragma once
+#include "CCalibrationFile.h"
+#include <cstdio>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @class CCalibrationJournal
+ * @brief Keeps a CCalibrationMap in step with a snapshot file and an append-only journal.
+ *
+ * The files are Path + ".snapshot" and Path + ".journal". Records carry a sequence
+ * number and the snapshot stores the last sequence it includes, so a crash between
+ * writing a snapshot and truncating the journal replays nothing twice.
+ */
+class CCalibrationJournal
+{
+public:
+  CCalibrationJournal() = default;
+  CCalibrationJournal(const CCalibrationJournal&) = delete;
+  CCalibrationJournal& operator=(const CCalibrationJournal&) = delete;
+
+  ~CCalibrationJournal()
+  {
+    Close();
+  }
+
+  /**
+   * @brief Opens the journal, recovering the map from the snapshot and journal tail.
+   * @param Path Base path of the snapshot and journal files.
+   * @param SnapshotInterval Records appended before a snapshot is taken automatically, or zero to disable.
+   * @param Durable If true, every record is flushed to stable storage before the edit returns.
+   * @throws std::runtime_error if the files cannot be opened or the snapshot is corrupt.
+   */
+  void Open(const std::string& Path, size_t SnapshotInterval = 4096, bool Durable = false)
+  {
+    Close();
+    m_Path = Path;
+    m_SnapshotInterval = SnapshotInterval;
+    m_Durable = Durable;
+    m_Sequence = 0;
+    m_RecordsSinceSnapshot = 0;
+    m_Map = CCalibrationMap();
+
+    std::ifstream Snapshot(SnapshotPath(), std::ios::binary);
+    if (Snapshot)
+    {
+      CCalibrationFile::ReadValue(Snapshot, m_Sequence);
+      m_Map = CCalibrationFile::ReadBinary(Snapshot);
+    }
+
+    uintmax_t ValidBytes = Replay();
+    if (std::filesystem::exists(JournalPath()))
+      std::filesystem::resize_file(JournalPath(), ValidBytes);
+
+    m_Journal = std::fopen(JournalPath().c_str(), "ab");
+    if (m_Journal == nullptr)
+      throw std::runtime_error("Unable to open calibration journal " + JournalPath() + ".");
+  }
+
+  /**
+   * @brief Closes the journal files. Edits already returned remain recoverable.
+   */
+  void Close()
+  {
+    if (m_Journal != nullptr)
+      std::fclose(m_Journal);
+    m_Journal = nullptr;
+  }
+
+  /**
+   * @brief Journals and applies CCalibrationMap::AddPoint().
+   * @param Nominal The nominal value.
+   * @param Calibrated The corresponding calibrated value.
+   * @throws std::runtime_error if the record cannot be written.
+   */
+  void AddPoint(double Nominal, double Calibrated)
+  {
+    Append(AddRecord, Nominal, Calibrated);
+    m_Map.AddPoint(Nominal, Calibrated);
+    AfterAppend();
+  }
+
+  /**
+   * @brief Journals and applies CCalibrationMap::RemovePoint().
+   * @param Nominal The nominal value of the point to remove.
+   * @throws std::runtime_error if the record cannot be written.
+   */
+  void RemovePoint(double Nominal)
+  {
+    Append(RemoveRecord, Nominal, 0.0);
+    m_Map.RemovePoint(Nominal);
+    AfterAppend();
+  }
+
+  /**
+   * @brief Applies CCalibrationMap::SetMap() and records it as a snapshot.
+   *
+   * Replacing the whole map is an O(map) edit, so it is persisted by taking a
+   * snapshot rather than by journaling every point.
+   * @param Map A map of nominal values and their error values.
+   * @throws std::runtime_error if the snapshot cannot be written.
+   */
+  void SetMap(std::map<double, double> Map)
+  {
+    m_Map.SetMap(std::move(Map));
+    ++m_Sequence;
+    Snapshot();
+  }
+
+  /**
+   * @brief Writes a snapshot of the map and truncates the journal.
+   *
+   * The snapshot is written to a temporary file, flushed to stable storage and
+   * renamed over the previous one, and the directory is synced so the rename itself
+   * is durable. Only then is the journal truncated, so a crash leaves either the old
+   * snapshot with its journal or the new snapshot intact.
+   * @throws std::runtime_error if the snapshot cannot be written.
+   */
+  void Snapshot()
+  {
+    if (m_Journal == nullptr)
+      throw std::runtime_error("Calibration journal is not open.");
+
+    std::string Temporary = SnapshotPath() + ".tmp";
+    std::FILE* File = std::fopen(Temporary.c_str(), "wb");
+    if (File == nullptr)
+      throw std::runtime_error("Unable to write calibration snapshot " + Temporary + ".");
+
+    std::ostringstream Contents;
+    CCalibrationFile::WriteValue(Contents, m_Sequence);
+    CCalibrationFile::WriteBinary(Contents, m_Map);
+    std::string Bytes = Contents.str();
+    bool Written = std::fwrite(Bytes.data(), 1, Bytes.size(), File) == Bytes.size() && Flush(File, true);
+    std::fclose(File);
+    if (!Written)
+      throw std::runtime_error("Unable to write calibration snapshot " + Temporary + ".");
+
+    std::filesystem::rename(Temporary, SnapshotPath());
+    if (!SyncDirectory(SnapshotPath()))
+      throw std::runtime_error("Unable to sync calibration snapshot " + SnapshotPath() + ".");
+
+    Close();
+    m_Journal = std::fopen(JournalPath().c_str(), "wb");
+    if (m_Journal == nullptr)
+      throw std::runtime_error("Unable to open calibration journal " + JournalPath() + ".");
+    if (!Flush(m_Journal, true))
+      throw std::runtime_error("Unable to write calibration journal " + JournalPath() + ".");
+    m_RecordsSinceSnapshot = 0;
+  }
+
+  /**
+   * @brief Gets the recovered and edited calibration map.
+   *
+   * Edits must go through the journal to be persisted.
+   * @return The calibration map.
+   */
+  CCalibrationMap& GetMap()
+  {
+    return m_Map;
+  }
+
+  /**
+   * @brief Gets the sequence number of the last edit.
+   * @return The sequence number.
+   */
+  uint64_t GetSequence()
+  {
+    return m_Sequence;
+  }
+
+private:
+  /**
+   * @brief Record type for AddPoint().
+   */
+  static const uint8_t AddRecord = 1;
+
+  /**
+   * @brief Record type for RemovePoint().
+   */
+  static const uint8_t RemoveRecord = 2;
+
+  /**
+   * @brief Bytes in a record before its checksum: type, sequence, nominal and value.
+   */
+  static const size_t RecordBody = 1 + 8 + 8 + 8;
+
+  /**
+   * @brief The journaled map.
+   */
+  CCalibrationMap m_Map;
+
+  /**
+   * @brief Base path of the snapshot and journal files.
+   */
+  std::string m_Path;
+
+  /**
+   * @brief The journal, open for appending.
+   */
+  std::FILE* m_Journal = nullptr;
+
+  /**
+   * @brief Sequence number of the last edit.
+   */
+  uint64_t m_Sequence = 0;
+
+  /**
+   * @brief Records appended since the last snapshot.
+   */
+  size_t m_RecordsSinceSnapshot = 0;
+
+  /**
+   * @brief Records between automatic snapshots, or zero.
+   */
+  size_t m_SnapshotInterval = 0;
+
+  /**
+   * @brief Whether records are flushed to stable storage.
+   */
+  bool m_Durable = false;
+
+  std::string SnapshotPath()
+  {
+    return m_Path + ".snapshot";
+  }
+
+  std::string JournalPath()
+  {
+    return m_Path + ".journal";
+  }
+
+  /**
+   * @brief Appends one record to the journal.
+   * @param Type The record type.
+   * @param Nominal The nominal value.
+   * @param Value The calibrated value, if the record has one.
+   * @throws std::runtime_error if the record cannot be written.
+   */
+  void Append(uint8_t Type, double Nominal, double Value)
+  {
+    if (m_Journal == nullptr)
+      throw std::runtime_error("Calibration journal is not open.");
+
+    uint64_t Sequence = m_Sequence + 1;
+    unsigned char Record[RecordBody + 4];
+    Record[0] = Type;
+    std::memcpy(Record + 1, &Sequence, 8);
+    std::memcpy(Record + 9, &Nominal, 8);
+    std::memcpy(Record + 17, &Value, 8);
+    uint32_t Crc = CCalibrationFile::Crc32(Record, RecordBody);
+    std::memcpy(Record + RecordBody, &Crc, 4);
+
+    if (std::fwrite(Record, 1, sizeof(Record), m_Journal) != sizeof(Record) || !Flush(m_Journal, m_Durable))
+      throw std::runtime_error("Unable to write calibration journal " + JournalPath() + ".");
+    m_Sequence = Sequence;
+  }
+
+  /**
+   * @brief Takes a snapshot once enough records have been appended.
+   */
+  void AfterAppend()
+  {
+    if (m_SnapshotInterval != 0 && ++m_RecordsSinceSnapshot >= m_SnapshotInterval)
+      Snapshot();
+  }
+
+  /**
+   * @brief Replays journal records newer than the snapshot.
+   * @return Length of the valid journal prefix in bytes.
+   */
+  uintmax_t Replay()
+  {
+    std::ifstream Journal(JournalPath(), std::ios::binary);
+    uintmax_t ValidBytes = 0;
+    unsigned char Record[RecordBody + 4];
+    while (Journal.read(reinterpret_cast<char*>(Record), sizeof(Record)))
+    {
+      uint32_t Crc;
+      std::memcpy(&Crc, Record + RecordBody, 4);
+      if (Crc != CCalibrationFile::Crc32(Record, RecordBody))
+        break;
+
+      uint64_t Sequence;
+      double Nominal;
+      double Value;
+      std::memcpy(&Sequence, Record + 1, 8);
+      std::memcpy(&Nominal, Record + 9, 8);
+      std::memcpy(&Value, Record + 17, 8);
+
+      if (Sequence > m_Sequence)
+      {
+        if (Record[0] == AddRecord)
+          m_Map.AddPoint(Nominal, Value);
+        else if (Record[0] == RemoveRecord)
+          m_Map.RemovePoint(Nominal);
+        else
+          break;
+        m_Sequence = Sequence;
+        ++m_RecordsSinceSnapshot;
+      }
+      ValidBytes += sizeof(Record);
+    }
+    return ValidBytes;
+  }
+
+  /**
+   * @brief Flushes buffered writes, optionally to stable storage.
+   * @param File The file to flush.
+   * @param Durable If true, waits until the data reaches the device.
+   * @return False on failure.
+   */
+  static bool Flush(std::FILE* File, bool Durable)
+  {
+    if (std::fflush(File) != 0)
+      return false;
+    if (!Durable)
+      return true;
+#if defined(_WIN32)
+    return _commit(_fileno(File)) == 0;
+#else
+    return fsync(fileno(File)) == 0;
+#endif
+  }
+
+  /**
+   * @brief Flushes the directory entry of a file to stable storage.
+   *
+   * Windows persists renames with the file's metadata, so this is a no-op there.
+   * @param Path The file whose directory is synced.
+   * @return False on failure.
+   */
+  static bool SyncDirectory(const std::string& Path)
+  {
+#if defined(_WIN32)
+    (void)Path;
+    return true;
+#else
+    std::filesystem::path Directory = std::filesystem::path(Path).parent_path();
+    if (Directory.empty())
+      Directory = ".";
+    int Descriptor = ::open(Directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (Descriptor < 0)
+      return false;
+    bool Synced = fsync(Descriptor) == 0;
+    ::close(Descriptor);
+    return Synced;
+#endif
+  }
+};
@@ -0,0 +1,542 @@
+/**
+ * @file CCalibrationLoader.h
+ * @brief Defines the CCalibrationLoader class for loading many calibration files at once.
+ *
+ * Loading thousands of small files with blocking reads serialises on I/O latency.
+ * On Linux the loader submits every open, stat and read to an io_uring and parses
+ * each file as its read completes. Elsewhere, or when the running kernel lacks
+ * io_uring or these opcodes (Linux 5.6), it falls back to a pool of threads issuing
+ * blocking calls.
+ */
+
+#pragma once
+#include "CCalibrationFile.h"
+#include <atomic>
+#include <thread>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define CALIBRATIONMAP_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+/**
+ * @class CCalibrationLoader
+ * @brief Loads calibration files in bulk.
+ *
+ * Every method returns one map per path, in the order of the paths.
+ */
+class CCalibrationLoader
+{
+public:
+  /**
+   * @brief Loads files with io_uring when available, otherwise with a thread pool.
+   * @param Paths The files to load.
+   * @return The calibration maps.
+   * @throws std::runtime_error if a file cannot be read.
+   * @throws std::invalid_argument if a file is malformed.
+   */
+  static std::vector<CCalibrationMap> Load(const std::vector<std::string>& Paths)
+  {
+    std::vector<CCalibrationMap> Maps;
+    if (LoadUring(Paths, Maps))
+      return Maps;
+    return LoadThreaded(Paths);
+  }
+
+  /**
+   * @brief Loads files one after another with blocking reads.
+   * @param Paths The files to load.
+   * @return The calibration maps.
+   * @throws std::runtime_error if a file cannot be read.
+   * @throws std::invalid_argument if a file is malformed.
+   */
+  static std::vector<CCalibrationMap> LoadSequential(const std::vector<std::string>& Paths)
+  {
+    std::vector<CCalibrationMap> Maps;
+    Maps.reserve(Paths.size());
+    for (size_t i = 0; i < Paths.size(); ++i)
+      Maps.push_back(CCalibrationFile::LoadText(Paths[i]));
+    return Maps;
+  }
+
+  /**
+   * @brief Loads files with a pool of threads issuing blocking reads.
+   * @param Paths The files to load.
+   * @param Threads Number of threads, or zero for twice the hardware concurrency.
+   * @return The calibration maps.
+   * @throws std::runtime_error if a file cannot be read.
+   * @throws std::invalid_argument if a file is malformed.
+   */
+  static std::vector<CCalibrationMap> LoadThreaded(const std::vector<std::string>& Paths, size_t Threads = 0)
+  {
+    if (Threads == 0)
+      Threads = std::max<size_t>(2, 2 * std::thread::hardware_concurrency());
+    Threads = std::min(Threads, std::max<size_t>(1, Paths.size()));
+
+    std::vector<CCalibrationMap> Maps(Paths.size());
+    std::vector<std::exception_ptr> Errors(Paths.size());
+    std::atomic<size_t> Next(0);
+
+    auto Worker = [&]()
+    {
+      for (size_t i = Next++; i < Paths.size(); i = Next++)
+      {
+        try
+        {
+          Maps[i] = CCalibrationFile::LoadText(Paths[i]);
+        }
+        catch (...)
+        {
+          Errors[i] = std::current_exception();
+        }
+      }
+    };
+
+    std::vector<std::thread> Pool;
+    for (size_t t = 1; t < Threads; ++t)
+      Pool.emplace_back(Worker);
+    Worker();
+    for (size_t t = 0; t < Pool.size(); ++t)
+      Pool[t].join();
+
+    for (size_t i = 0; i < Errors.size(); ++i)
+      if (Errors[i])
+        std::rethrow_exception(Errors[i]);
+    return Maps;
+  }
+
+  /**
+   * @brief Loads files through an io_uring, parsing each file as its read completes.
+   *
+   * Each file's open and size query are submitted together, keeping up to the ring
+   * depth of operations in flight, and its read follows once both complete, so no
+   * step blocks on storage latency. Files are closed once parsed. Short reads are
+   * resubmitted for the remaining bytes. After an error nothing new is queued, but
+   * outstanding operations are drained before the error is rethrown so the kernel
+   * never writes into freed buffers. This includes the kernel rejecting a
+   * submission while earlier operations are in flight.
+   * @param Paths The files to load.
+   * @param Maps Receives the calibration maps.
+   * @param QueueDepth Number of submission queue entries.
+   * @return False if io_uring or its open, stat or read opcode is unavailable, in which case Maps is untouched.
+   * @throws std::runtime_error if a file cannot be read.
+   * @throws std::invalid_argument if a file is malformed.
+   */
+  static bool LoadUring(const std::vector<std::string>& Paths, std::vector<CCalibrationMap>& Maps, unsigned QueueDepth = 256)
+  {
+#if defined(CALIBRATIONMAP_HAS_IO_URING)
+    // Declared before the ring so the ring is torn down before the buffers are freed.
+    std::vector<CPendingFile> Files(Paths.size());
+    std::vector<CCalibrationMap> Loaded(Paths.size());
+    CRing Ring;
+    if (!Ring.Open(QueueDepth))
+      return false;
+
+    std::exception_ptr Error;
+    size_t Started = 0;
+    size_t InFlight = 0;
+
+    try
+    {
+      while (InFlight > 0 || (!Error && Started < Files.size()))
+      {
+        while (!Error && Started < Files.size() && InFlight + 2 <= Ring.Entries())
+        {
+          Ring.QueueOpen(Paths[Started], Started * StageCount + OpenStage);
+          Ring.QueueStat(Paths[Started], Files[Started], Started * StageCount + StatStage);
+          Files[Started].Setup = 2;
+          ++Started;
+          InFlight += 2;
+        }
+
+        if (InFlight == 0)
+          break;
+        Ring.Submit(1);
+
+        struct io_uring_cqe Completion;
+        while (Ring.Reap(Completion))
+        {
+          --InFlight;
+          size_t Index = static_cast<size_t>(Completion.user_data / StageCount);
+          size_t Stage = static_cast<size_t>(Completion.user_data % StageCount);
+          CPendingFile& File = Files[Index];
+
+          if (Stage != ReadStage)
+          {
+            if (Completion.res < 0)
+              File.Failed = true;
+            else if (Stage == OpenStage)
+              File.Descriptor = Completion.res;
+            if (--File.Setup > 0)
+              continue;
+
+            if (File.Failed && !Error)
+              Error = std::make_exception_ptr(std::runtime_error("Unable to open calibration file " + Paths[Index] + "."));
+            if (Error)
+            {
+              File.Close();
+              continue;
+            }
+            File.Buffer.resize(static_cast<size_t>(File.Status.stx_size));
+            Ring.QueueRead(File, Index * StageCount + ReadStage);
+            ++InFlight;
+            continue;
+          }
+
+          if (Completion.res > 0)
+          {
+            File.Offset += static_cast<size_t>(Completion.res);
+            if (File.Offset < File.Buffer.size() && !Error)
+            {
+              Ring.QueueRead(File, Index * StageCount + ReadStage);
+              ++InFlight;
+              continue;
+            }
+          }
+
+          if (!Error)
+          {
+            try
+            {
+              if (Completion.res < 0)
+                throw std::runtime_error("Unable to read calibration file " + Paths[Index] + ".");
+              CCalibrationFile::ParseText(File.Buffer.data(), File.Offset, Loaded[Index]);
+            }
+            catch (...)
+            {
+              Error = std::current_exception();
+            }
+          }
+          File.Close();
+        }
+      }
+    }
+    catch (...)
+    {
+      Error = std::current_exception();
+      Ring.Drain([&](const struct io_uring_cqe& Completion)
+      {
+        if (Completion.user_data % StageCount == OpenStage && Completion.res >= 0)
+          Files[Completion.user_data / StageCount].Descriptor = Completion.res;
+      });
+    }
+
+    if (Error)
+      std::rethrow_exception(Error);
+
+    Maps.swap(Loaded);
+    return true;
+#else
+    (void)Paths;
+    (void)Maps;
+    (void)QueueDepth;
+    return false;
+#endif
+  }
+
+private:
+#if defined(CALIBRATIONMAP_HAS_IO_URING)
+  /**
+   * @brief Operation kinds encoded with the file index in a completion's user_data.
+   */
+  static const uint64_t OpenStage = 0;
+  static const uint64_t StatStage = 1;
+  static const uint64_t ReadStage = 2;
+  static const uint64_t StageCount = 3;
+
+  /**
+   * @brief A file being read through the ring.
+   */
+  struct CPendingFile
+  {
+    int Descriptor = -1;
+    std::vector<char> Buffer;
+    size_t Offset = 0;
+    struct statx Status;  ///< Filled by the kernel's statx.
+    int Setup = 0;        ///< Open and stat operations still outstanding.
+    bool Failed = false;  ///< The open or stat failed.
+
+    CPendingFile() = default;
+    CPendingFile(const CPendingFile&) = delete;
+    CPendingFile& operator=(const CPendingFile&) = delete;
+
+    ~CPendingFile()
+    {
+      Close();
+    }
+
+    void Close()
+    {
+      if (Descriptor >= 0)
+        ::close(Descriptor);
+      Descriptor = -1;
+      std::vector<char>().swap(Buffer);
+    }
+  };
+
+  /**
+   * @class CRing
+   * @brief Minimal io_uring wrapper using the raw system calls.
+   */
+  class CRing
+  {
+  public:
+    ~CRing()
+    {
+      if (m_Entries != MAP_FAILED && m_Entries != nullptr)
+        ::munmap(m_Entries, m_EntriesSize);
+      if (m_CompletionRing != MAP_FAILED && m_CompletionRing != nullptr && m_CompletionRing != m_SubmissionRing)
+        ::munmap(m_CompletionRing, m_CompletionRingSize);
+      if (m_SubmissionRing != MAP_FAILED && m_SubmissionRing != nullptr)
+        ::munmap(m_SubmissionRing, m_SubmissionRingSize);
+      if (m_Descriptor >= 0)
+        ::close(m_Descriptor);
+    }
+
+    /**
+     * @brief Creates the ring and maps its queues.
+     * @param Depth Requested number of submission queue entries.
+     * @return False if the kernel does not provide io_uring or the opcodes the loader uses.
+     */
+    bool Open(unsigned Depth)
+    {
+      struct io_uring_params Params;
+      std::memset(&Params, 0, sizeof(Params));
+      m_Descriptor = static_cast<int>(::syscall(__NR_io_uring_setup, Depth, &Params));
+      if (m_Descriptor < 0)
+        return false;
+
+      m_SubmissionRingSize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+      m_CompletionRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+      bool SingleMap = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (SingleMap)
+        m_SubmissionRingSize = m_CompletionRingSize = std::max(m_SubmissionRingSize, m_CompletionRingSize);
+
+      m_SubmissionRing = ::mmap(nullptr, m_SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        m_Descriptor, IORING_OFF_SQ_RING);
+      if (m_SubmissionRing == MAP_FAILED)
+        return false;
+
+      m_CompletionRing = SingleMap ? m_SubmissionRing : ::mmap(nullptr, m_CompletionRingSize,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Descriptor, IORING_OFF_CQ_RING);
+      if (m_CompletionRing == MAP_FAILED)
+        return false;
+
+      m_EntriesSize = Params.sq_entries * sizeof(struct io_uring_sqe);
+      m_Entries = ::mmap(nullptr, m_EntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        m_Descriptor, IORING_OFF_SQES);
+      if (m_Entries == MAP_FAILED)
+        return false;
+
+      char* Submission = static_cast<char*>(m_SubmissionRing);
+      m_SubmissionHead = reinterpret_cast<unsigned*>(Submission + Params.sq_off.head);
+      m_SubmissionTail = reinterpret_cast<unsigned*>(Submission + Params.sq_off.tail);
+      m_SubmissionMask = *reinterpret_cast<unsigned*>(Submission + Params.sq_off.ring_mask);
+      m_SubmissionArray = reinterpret_cast<unsigned*>(Submission + Params.sq_off.array);
+
+      char* Completion = static_cast<char*>(m_CompletionRing);
+      m_CompletionHead = reinterpret_cast<unsigned*>(Completion + Params.cq_off.head);
+      m_CompletionTail = reinterpret_cast<unsigned*>(Completion + Params.cq_off.tail);
+      m_CompletionMask = *reinterpret_cast<unsigned*>(Completion + Params.cq_off.ring_mask);
+      m_Completions = reinterpret_cast<struct io_uring_cqe*>(Completion + Params.cq_off.cqes);
+
+      m_Depth = Params.sq_entries;
+      return SupportsOperations();
+    }
+
+    /**
+     * @brief Gets the number of submission queue entries.
+     * @return The ring depth.
+     */
+    size_t Entries()
+    {
+      return m_Depth;
+    }
+
+    /**
+     * @brief Queues opening a file for reading.
+     * @param Path The file. It must stay alive until the completion is reaped.
+     * @param Tag Value returned in the completion's user_data.
+     */
+    void QueueOpen(const std::string& Path, uint64_t Tag)
+    {
+      struct io_uring_sqe* Entry = NextEntry();
+      Entry->opcode = IORING_OP_OPENAT;
+      Entry->fd = AT_FDCWD;
+      Entry->addr = reinterpret_cast<unsigned long long>(Path.c_str());
+      Entry->open_flags = O_RDONLY | O_CLOEXEC;
+      Commit(Entry, Tag);
+    }
+
+    /**
+     * @brief Queues a query of a file's size.
+     * @param Path The file. It must stay alive until the completion is reaped.
+     * @param File Receives the size in its Status.
+     * @param Tag Value returned in the completion's user_data.
+     */
+    void QueueStat(const std::string& Path, CPendingFile& File, uint64_t Tag)
+    {
+      struct io_uring_sqe* Entry = NextEntry();
+      Entry->opcode = IORING_OP_STATX;
+      Entry->fd = AT_FDCWD;
+      Entry->addr = reinterpret_cast<unsigned long long>(Path.c_str());
+      Entry->len = STATX_SIZE;
+      Entry->off = reinterpret_cast<unsigned long long>(&File.Status);
+      Commit(Entry, Tag);
+    }
+
+    /**
+     * @brief Queues a read of the remaining bytes of a file.
+     * @param File The file being read.
+     * @param Tag Value returned in the completion's user_data.
+     */
+    void QueueRead(CPendingFile& File, uint64_t Tag)
+    {
+      struct io_uring_sqe* Entry = NextEntry();
+      Entry->opcode = IORING_OP_READ;
+      Entry->fd = File.Descriptor;
+      Entry->addr = reinterpret_cast<unsigned long long>(File.Buffer.data() + File.Offset);
+      Entry->len = static_cast<unsigned>(File.Buffer.size() - File.Offset);
+      Entry->off = File.Offset;
+      Commit(Entry, Tag);
+    }
+
+    /**
+     * @brief Submits queued operations and optionally waits for completions.
+     * @param WaitFor Number of completions to wait for.
+     * @throws std::runtime_error if the kernel rejects the submission.
+     */
+    void Submit(unsigned WaitFor)
+    {
+      for (;;)
+      {
+        int Result = static_cast<int>(::syscall(__NR_io_uring_enter, m_Descriptor, m_Queued, WaitFor,
+          WaitFor > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+        if (Result >= 0)
+        {
+          m_Queued -= static_cast<unsigned>(Result);
+          m_Submitted += static_cast<unsigned>(Result);
+          return;
+        }
+        if (errno != EINTR)
+          throw std::runtime_error("io_uring submission failed.");
+      }
+    }
+
+    /**
+     * @brief Waits for every completion of operations already submitted.
+     *
+     * Operations queued but never submitted are left in the ring, which the kernel
+     * only consumes on submission, so the buffers may be released afterwards. A
+     * wait-only io_uring_enter can fail only transiently (EINTR, EAGAIN, EBUSY), so
+     * errors are retried rather than abandoning operations still in flight.
+     * @param Handle Called with each completion, for example to close opened files.
+     */
+    template <typename THandler>
+    void Drain(THandler Handle)
+    {
+      struct io_uring_cqe Completion;
+      while (m_Submitted > 0)
+      {
+        if (Reap(Completion))
+        {
+          Handle(Completion);
+          continue;
+        }
+        ::syscall(__NR_io_uring_enter, m_Descriptor, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+      }
+    }
+
+    /**
+     * @brief Takes the next completion, if any.
+     * @param Completion Receives the completion.
+     * @return False if the completion queue is empty.
+     */
+    bool Reap(struct io_uring_cqe& Completion)
+    {
+      unsigned Head = *m_CompletionHead;
+      if (Head == __atomic_load_n(m_CompletionTail, __ATOMIC_ACQUIRE))
+        return false;
+      Completion = m_Completions[Head & m_CompletionMask];
+      __atomic_store_n(m_CompletionHead, Head + 1, __ATOMIC_RELEASE);
+      --m_Submitted;
+      return true;
+    }
+
+  private:
+    /**
+     * @brief Asks the kernel whether it implements IORING_OP_OPENAT, IORING_OP_STATX and IORING_OP_READ.
+     * @return False if the probe is unsupported (before Linux 5.6) or an opcode is missing.
+     */
+    bool SupportsOperations()
+    {
+      const unsigned Operations = 256;
+      std::vector<unsigned char> Storage(sizeof(struct io_uring_probe) + Operations * sizeof(struct io_uring_probe_op));
+      struct io_uring_probe* Probe = reinterpret_cast<struct io_uring_probe*>(Storage.data());
+      if (::syscall(__NR_io_uring_register, m_Descriptor, IORING_REGISTER_PROBE, Probe, Operations) < 0)
+        return false;
+      const unsigned Required[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ };
+      for (unsigned Opcode : Required)
+        if (Probe->last_op < Opcode || (Probe->ops[Opcode].flags & IO_URING_OP_SUPPORTED) == 0)
+          return false;
+      return true;
+    }
+
+    /**
+     * @brief Gets the next submission queue entry, cleared.
+     * @return The entry.
+     */
+    struct io_uring_sqe* NextEntry()
+    {
+      unsigned Slot = *m_SubmissionTail & m_SubmissionMask;
+      struct io_uring_sqe* Entry = static_cast<struct io_uring_sqe*>(m_Entries) + Slot;
+      std::memset(Entry, 0, sizeof(*Entry));
+      return Entry;
+    }
+
+    /**
+     * @brief Makes an entry from NextEntry() visible to the kernel.
+     * @param Entry The entry.
+     * @param Tag Value returned in the completion's user_data.
+     */
+    void Commit(struct io_uring_sqe* Entry, uint64_t Tag)
+    {
+      unsigned Tail = *m_SubmissionTail;
+      unsigned Slot = Tail & m_SubmissionMask;
+      Entry->user_data = Tag;
+      m_SubmissionArray[Slot] = Slot;
+      __atomic_store_n(m_SubmissionTail, Tail + 1, __ATOMIC_RELEASE);
+      ++m_Queued;
+    }
+
+    int m_Descriptor = -1;
+    unsigned m_Depth = 0;
+    unsigned m_Queued = 0;
+    unsigned m_Submitted = 0;
+
+    void* m_SubmissionRing = nullptr;
+    size_t m_SubmissionRingSize = 0;
+    unsigned* m_SubmissionHead = nullptr;
+    unsigned* m_SubmissionTail = nullptr;
+    unsigned m_SubmissionMask = 0;
+    unsigned* m_SubmissionArray = nullptr;
+
+    void* m_CompletionRing = nullptr;
+    size_t m_CompletionRingSize = 0;
+    unsigned* m_CompletionHead = nullptr;
+    unsigned* m_CompletionTail = nullptr;
+    unsigned m_CompletionMask = 0;
+    struct io_uring_cqe* m_Completions = nullptr;
+
+    void* m_Entries = nullptr;
+    size_t m_EntriesSize = 0;
+  };
+#endif
+};
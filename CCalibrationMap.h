@@ -12,10 +12,341 @@
  */
 
 #pragma once
+#include "CQueryCapture.h"
 #include <map>
+#include <memory>
 #include <vector>
 #include <stdexcept>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <type_traits>
+
+/**
+ * @class CStridedArray
+ * @brief Views values spaced a fixed number of bytes apart, such as one field of an array of structs.
+ * @tparam T The element type, const-qualified for read-only views.
+ */
+template <typename T>
+class CStridedArray
+{
+public:
+  /**
+   * @brief Creates a view over elements starting at Base and Stride bytes apart.
+   * @param Base Pointer to the first element.
+   * @param Stride Distance in bytes between consecutive elements.
+   */
+  CStridedArray(T* Base, size_t Stride)
+    : m_Base(reinterpret_cast<Byte*>(Base)), m_Stride(Stride)
+  {
+  }
+
+  /**
+   * @brief Creates a view over contiguous elements.
+   * @param Base Pointer to the first element.
+   */
+  CStridedArray(T* Base)
+    : CStridedArray(Base, sizeof(T))
+  {
+  }
+
+  /**
+   * @brief Accesses an element.
+   * @param Index The element index.
+   * @return Reference to the element.
+   */
+  T& operator[](size_t Index) const
+  {
+    return *reinterpret_cast<T*>(m_Base + Index * m_Stride);
+  }
+
+  /**
+   * @brief Creates a view starting at a later element with the same stride.
+   * @param First Index of the element that becomes the first of the new view.
+   * @return The shifted view.
+   */
+  CStridedArray Slice(size_t First) const
+  {
+    return CStridedArray(&(*this)[First], m_Stride);
+  }
+
+private:
+  typedef typename std::conditional<std::is_const<T>::value, const char, char>::type Byte;
+
+  /**
+   * @brief Address of the first element.
+   */
+  Byte* m_Base;
+
+  /**
+   * @brief Distance in bytes between consecutive elements.
+   */
+  size_t m_Stride;
+};
+
+/**
+ * @class CCorrectionCache
+ * @brief Lock-free, direct-mapped cache of corrected points keyed on the nominal's bit pattern.
+ *
+ * Each slot is guarded by a sequence number: a writer claims the slot by moving the
+ * number from even to odd and releases it by moving it to the next even value, and
+ * a reader accepts a slot only if the number was even and unchanged around its
+ * reads. A writer that loses the race simply skips the fill. Every slot records the
+ * map version it was computed for, so bumping the version invalidates all of them
+ * without touching the slots.
+ */
+class CCorrectionCache
+{
+public:
+  /**
+   * @brief Hit and miss counts since the cache was created or last reset.
+   */
+  struct Stats
+  {
+    uint64_t Hits = 0;    ///< Lookups answered from the cache.
+    uint64_t Misses = 0;  ///< Lookups that had to be computed.
+
+    /**
+     * @brief Gets the fraction of lookups answered from the cache.
+     * @return The hit rate, or zero before any lookup.
+     */
+    double HitRate() const
+    {
+      uint64_t Total = Hits + Misses;
+      return Total ? double(Hits) / Total : 0.0;
+    }
+  };
+
+  /**
+   * @brief Creates a cache.
+   * @param Entries Number of slots, rounded up to a power of two.
+   */
+  explicit CCorrectionCache(size_t Entries)
+  {
+    size_t Size = 1;
+    m_Shift = 64;
+    while (Size < Entries)
+    {
+      Size *= 2;
+      --m_Shift;
+    }
+    m_Mask = Size - 1;
+    m_Slots.reset(new CSlot[Size]);
+  }
+
+  /**
+   * @brief Looks up a nominal value.
+   * @param Nominal The nominal value.
+   * @param Version The current map version.
+   * @param Corrected Receives the cached corrected point on a hit.
+   * @return True on a hit.
+   */
+  bool Find(double Nominal, uint64_t Version, double& Corrected)
+  {
+    uint64_t Key = Bits(Nominal);
+    CSlot& Slot = m_Slots[Index(Key)];
+    uint64_t Before = Slot.Sequence.load(std::memory_order_acquire);
+    uint64_t SlotKey = Slot.Key.load(std::memory_order_relaxed);
+    uint64_t SlotValue = Slot.Value.load(std::memory_order_relaxed);
+    uint64_t SlotVersion = Slot.Version.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t After = Slot.Sequence.load(std::memory_order_relaxed);
+
+    if ((Before & 1) == 0 && Before == After && SlotKey == Key && SlotVersion == Version)
+    {
+      m_Hits.fetch_add(1, std::memory_order_relaxed);
+      std::memcpy(&Corrected, &SlotValue, sizeof(Corrected));
+      return true;
+    }
+    m_Misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  /**
+   * @brief Stores a corrected point, unless another thread is writing the same slot.
+   * @param Nominal The nominal value.
+   * @param Version The map version the value was computed for.
+   * @param Corrected The corrected point.
+   */
+  void Store(double Nominal, uint64_t Version, double Corrected)
+  {
+    uint64_t Key = Bits(Nominal);
+    CSlot& Slot = m_Slots[Index(Key)];
+    uint64_t Sequence = Slot.Sequence.load(std::memory_order_relaxed);
+    if ((Sequence & 1) != 0 || !Slot.Sequence.compare_exchange_strong(Sequence, Sequence + 1, std::memory_order_acquire))
+      return;
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot.Key.store(Key, std::memory_order_relaxed);
+    Slot.Value.store(Bits(Corrected), std::memory_order_relaxed);
+    Slot.Version.store(Version, std::memory_order_relaxed);
+    Slot.Sequence.store(Sequence + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Gets the hit and miss counts.
+   * @return The counts.
+   */
+  Stats GetStats()
+  {
+    Stats Counts;
+    Counts.Hits = m_Hits.load(std::memory_order_relaxed);
+    Counts.Misses = m_Misses.load(std::memory_order_relaxed);
+    return Counts;
+  }
+
+  /**
+   * @brief Resets the hit and miss counts to zero.
+   */
+  void ResetStats()
+  {
+    m_Hits = 0;
+    m_Misses = 0;
+  }
+
+  /**
+   * @brief Gets the number of slots.
+   * @return The slot count.
+   */
+  size_t Size()
+  {
+    return m_Mask + 1;
+  }
+
+  /**
+   * @brief Gets the heap bytes held by the slots.
+   * @return The slot array size in bytes.
+   */
+  size_t Bytes()
+  {
+    return Size() * sizeof(CSlot);
+  }
+
+private:
+  /**
+   * @struct CSlot
+   * @brief One cached corrected point.
+   */
+  struct CSlot
+  {
+    std::atomic<uint64_t> Sequence{ 0 };  ///< Even when stable, odd while being written.
+    std::atomic<uint64_t> Key{ 0 };       ///< Bit pattern of the nominal value.
+    std::atomic<uint64_t> Value{ 0 };     ///< Bit pattern of the corrected point.
+    std::atomic<uint64_t> Version{ 0 };   ///< Map version the value belongs to; zero is never current.
+  };
+
+  /**
+   * @brief The slots.
+   */
+  std::unique_ptr<CSlot[]> m_Slots;
+
+  /**
+   * @brief Slot count minus one.
+   */
+  size_t m_Mask = 0;
+
+  /**
+   * @brief Shift that keeps the top bits of the hash product as the slot index.
+   */
+  unsigned m_Shift = 64;
+
+  /**
+   * @brief Lookups answered from the cache.
+   */
+  std::atomic<uint64_t> m_Hits{ 0 };
+
+  /**
+   * @brief Lookups that had to be computed.
+   */
+  std::atomic<uint64_t> m_Misses{ 0 };
+
+  /**
+   * @brief Gets the bit pattern of a double.
+   * @param Value The value.
+   * @return Its bits.
+   */
+  static uint64_t Bits(double Value)
+  {
+    uint64_t Result;
+    std::memcpy(&Result, &Value, sizeof(Result));
+    return Result;
+  }
+
+  /**
+   * @brief Maps a key to a slot with a multiplicative hash.
+   *
+   * The top bits of the product are used because setpoints often have many
+   * trailing zero mantissa bits, which leave the low bits of the product zero.
+   * @param Key The nominal's bit pattern.
+   * @return The slot index.
+   */
+  size_t Index(uint64_t Key)
+  {
+    return m_Shift == 64 ? 0 : static_cast<size_t>((Key * 0x9E3779B97F4A7C15ull) >> m_Shift);
+  }
+};
+
+/**
+ * @struct CMemoryFootprint
+ * @brief Bytes used by each representation of a calibration map.
+ *
+ * Tree sizes are estimates: a red-black tree node holds three pointers, a colour
+ * and the key/value pair, and the allocator adds a header and rounds each block to
+ * twice the pointer size. Vector sizes use their capacity.
+ */
+struct CMemoryFootprint
+{
+  size_t TreeBytes = 0;         ///< std::map nodes holding the breakpoints.
+  size_t FrozenBytes = 0;       ///< Flat frozen lookup tables.
+  size_t CompressedBytes = 0;   ///< Compressed residual tables.
+  size_t CoefficientBytes = 0;  ///< Fitted series coefficients.
+  size_t CacheBytes = 0;        ///< Lookup caches.
+  size_t IndexBytes = 0;        ///< Containers indexing a bank of maps, such as registry slots.
+
+  /**
+   * @brief Gets the total over all representations.
+   * @return The total in bytes.
+   */
+  size_t Total() const
+  {
+    return TreeBytes + FrozenBytes + CompressedBytes + CoefficientBytes + CacheBytes + IndexBytes;
+  }
+
+  /**
+   * @brief Adds another footprint, for aggregating over a bank of maps.
+   * @param Other The footprint to add.
+   * @return This footprint.
+   */
+  CMemoryFootprint& operator+=(const CMemoryFootprint& Other)
+  {
+    TreeBytes += Other.TreeBytes;
+    FrozenBytes += Other.FrozenBytes;
+    CompressedBytes += Other.CompressedBytes;
+    CoefficientBytes += Other.CoefficientBytes;
+    CacheBytes += Other.CacheBytes;
+    IndexBytes += Other.IndexBytes;
+    return *this;
+  }
+
+  /**
+   * @brief Estimates the heap bytes of one std::map node.
+   * @tparam TValue The map's value_type.
+   * @return The estimated bytes per node, including allocator overhead.
+   */
+  template <typename TValue>
+  static size_t TreeNodeBytes()
+  {
+    size_t Alignment = 2 * sizeof(void*);
+    size_t Node = 4 * sizeof(void*) + sizeof(TValue) + sizeof(void*);
+    return (Node + Alignment - 1) / Alignment * Alignment;
+  }
+};
 
  /**
   * @class CCalibrationMap
@@ -24,10 +355,158 @@
   * This class stores calibration data, allowing for error correction
   * and interpolation. It supports adding data points, retrieving errors,
   * and computing corrected positions.
+  *
+  * Copies share the breakpoint tree and frozen table, so copying a map is O(1).
+  * A map clones the tree the first time it is modified while shared.
   */
 class CCalibrationMap
 {
 public:
+  /**
+   * @brief Selects how collinear segments are merged when freezing the map.
+   */
+  enum class MergeMode
+  {
+    None,                ///< Keep every breakpoint.
+    ExactAtBreakpoints,  ///< Merge only when every removed breakpoint is reproduced bit-for-bit. Lookups between breakpoints can still differ by rounding.
+    Tolerance            ///< Merge when every removed breakpoint is reproduced within FreezeOptions::Tolerance.
+  };
+
+  /**
+   * @brief Selects the precision of the error column in the frozen table.
+   *
+   * Nominal values are always stored as double so the search is unaffected.
+   */
+  enum class StorageType
+  {
+    Double,  ///< Errors stored as double.
+    Float    ///< Errors stored as float, halving the error column.
+  };
+
+  /**
+   * @brief Options controlling how the frozen lookup table is built.
+   */
+  struct FreezeOptions
+  {
+    MergeMode Merge = MergeMode::None;  ///< Collinear segment merging strategy.
+    double Tolerance = 0.0;             ///< Maximum absolute error deviation for MergeMode::Tolerance.
+    double ErrorBudget = 0.0;           ///< Largest acceptable float deviation; zero always stores double.
+  };
+
+  /**
+   * @brief Describes the frozen lookup table produced by Freeze().
+   */
+  struct FreezeReport
+  {
+    size_t SourcePoints = 0;                    ///< Breakpoints in the calibration map.
+    size_t FrozenPoints = 0;                    ///< Breakpoints kept in the frozen table.
+    StorageType Storage = StorageType::Double;  ///< Precision chosen for the error column.
+    double FloatDeviation = 0.0;                ///< Worst float deviation measured, when a budget was given.
+  };
+
+  /**
+   * @brief Flat, sorted lookup table built by Freeze().
+   *
+   * The table is self-contained, so it can be copied elsewhere (for example into
+   * node-local memory) and searched without the map that built it.
+   */
+  struct FrozenTable
+  {
+    std::vector<double> Nominals;               ///< Sorted nominal values.
+    std::vector<double> Errors;                 ///< Matching error values, when stored as double.
+    std::vector<float> FloatErrors;             ///< Matching error values, when stored as float.
+    StorageType Storage = StorageType::Double;  ///< Which error column is in use.
+
+    /**
+     * @brief Retrieves the error value, starting at a segment hint.
+     *
+     * The hinted segment and the one after it are checked before falling back to a
+     * binary search. Values within the snap tolerance of a breakpoint return its error.
+     * @param Nominal The nominal value.
+     * @param Cursor Segment hint, updated to the segment containing Nominal.
+     * @param SnapTolerance Distance within which a nominal value snaps to a breakpoint.
+     * @return The error value.
+     * @throws std::runtime_error if the table is empty.
+     * @throws std::out_of_range if the nominal value is outside the table range.
+     */
+    double ErrorValue(double Nominal, size_t& Cursor, double SnapTolerance) const
+    {
+      if (Storage == StorageType::Float)
+        return Lookup(FloatErrors.data(), Nominal, Cursor, SnapTolerance);
+      return Lookup(Errors.data(), Nominal, Cursor, SnapTolerance);
+    }
+
+    /**
+     * @brief Gets the heap bytes held by the table.
+     * @return The capacity of its columns in bytes.
+     */
+    size_t Bytes() const
+    {
+      return Nominals.capacity() * sizeof(double) + Errors.capacity() * sizeof(double)
+        + FloatErrors.capacity() * sizeof(float);
+    }
+
+  private:
+    /**
+     * @brief Searches the table and interpolates errors of the given precision.
+     * @param Column The error column in use.
+     * @param Nominal The nominal value.
+     * @param Cursor Segment hint, updated to the segment containing Nominal.
+     * @param SnapTolerance Distance within which a nominal value snaps to a breakpoint.
+     * @return The error value.
+     * @throws std::runtime_error if the table is empty.
+     * @throws std::out_of_range if the nominal value is outside the table range.
+     */
+    template <typename TError>
+    double Lookup(const TError* Column, double Nominal, size_t& Cursor, double SnapTolerance) const
+    {
+      const double* Breakpoints = Nominals.data();
+      size_t Count = Nominals.size();
+      if (Count == 0)
+        throw std::runtime_error("Calibration map is empty.");
+
+      size_t Index = Cursor;
+      if (!(Index + 1 < Count && Breakpoints[Index] <= Nominal && Nominal < Breakpoints[Index + 1]))
+      {
+        if (Index + 2 < Count && Breakpoints[Index + 1] <= Nominal && Nominal < Breakpoints[Index + 2])
+          ++Index;
+        else
+        {
+          Index = std::upper_bound(Breakpoints, Breakpoints + Count, Nominal) - Breakpoints;
+
+          if (Index == 0)
+          {
+            if (Breakpoints[0] - Nominal <= SnapTolerance)
+              return Column[0];
+            throw std::out_of_range("Nominal value outside of calibrated range.");
+          }
+
+          if (Index == Count)
+          {
+            if (Nominal - Breakpoints[Count - 1] <= SnapTolerance)
+              return Column[Count - 1];
+            throw std::out_of_range("Nominal value outside of calibrated range.");
+          }
+
+          --Index;
+        }
+      }
+
+      Cursor = Index;
+      double Below = Nominal - Breakpoints[Index];
+      double Above = Breakpoints[Index + 1] - Nominal;
+      if (Below <= Above)
+      {
+        if (Below <= SnapTolerance)
+          return Column[Index];
+      }
+      else if (Above <= SnapTolerance)
+        return Column[Index + 1];
+
+      return Interpolate(Nominal, Breakpoints[Index], Column[Index], Breakpoints[Index + 1], Column[Index + 1]);
+    }
+  };
+
   /**
    * @brief Adds a single calibration point.
    * @param Nominal The nominal value.
@@ -35,7 +514,7 @@ public:
    */
   void AddPoint(double Nominal, double Calibrated)
   {
-    m_CalibratedMap[Nominal] = Nominal - Calibrated;
+    MutableMap()[Nominal] = Nominal - Calibrated;
   }
 
   /**
@@ -53,13 +532,42 @@ public:
       AddPoint(Nominals[i], Calibrated[i]);
   }
 
+  /**
+   * @brief Sets the error value stored for a nominal value.
+   * @param Nominal The nominal value.
+   * @param Error The error value, stored exactly as given.
+   */
+  void SetErrorValue(double Nominal, double Error)
+  {
+    MutableMap()[Nominal] = Error;
+  }
+
+  /**
+   * @brief Removes a single calibration point.
+   * @param Nominal The nominal value of the point to remove. Missing points are ignored.
+   */
+  void RemovePoint(double Nominal)
+  {
+    MutableMap().erase(Nominal);
+  }
+
   /**
    * @brief Sets the calibration map.
    * @param Map A map of nominal values and their error values.
    */
   void SetMap(std::map<double, double> Map)
   {
-    m_CalibratedMap = Map;
+    Thaw();
+    m_CalibratedMap = std::make_shared<std::map<double, double>>(std::move(Map));
+  }
+
+  /**
+   * @brief Gets the calibration map.
+   * @return A map of nominal values and their error values.
+   */
+  const std::map<double, double>& GetMap()
+  {
+    return *m_CalibratedMap;
   }
 
   /**
@@ -68,11 +576,15 @@ public:
    */
   void AppendMap(std::map<double, double>& Map)
   {
-    m_CalibratedMap.insert(Map.begin(), Map.end());
+    MutableMap().insert(Map.begin(), Map.end());
   }
 
   /**
    * @brief Retrieves the error value for a given nominal input.
+   *
+   * A single search finds the breakpoints either side of the nominal value. If it
+   * lies within the snap tolerance of one of them, that breakpoint's error is
+   * returned as an exact hit; otherwise the neighbours are interpolated.
    * @param Nominal The nominal value.
    * @return The error value from the calibration map.
    * @throws std::runtime_error if the map is empty.
@@ -80,20 +592,65 @@ public:
    */
   double ErrorValue(double Nominal)
   {
-    if (m_CalibratedMap.empty())
-      throw std::runtime_error("Calibration map is empty.");
+    if (m_Capture)
+      m_Capture->Record(Nominal);
+    if (const FrozenTable* Table = CurrentTable())
+    {
+      size_t Cursor = 0;
+      return Table->ErrorValue(Nominal, Cursor, m_SnapTolerance);
+    }
 
-    auto it = m_CalibratedMap.find(Nominal);
-    if (it != m_CalibratedMap.end())
-      return it->second;
+    return TreeErrorValue(Nominal);
+  }
 
-    auto upper = m_CalibratedMap.upper_bound(Nominal);
-    auto lower = (upper == m_CalibratedMap.begin()) ? m_CalibratedMap.end() : std::prev(upper);
+  /**
+   * @brief Records every queried nominal value to a capture file for later replay.
+   *
+   * ErrorValue(), ErrorValueAt(), CorrectedPoint() and the batch calls record each
+   * value they are given, including cache hits. Copies of the map share the capture.
+   * It must not be changed while other threads are querying the map.
+   * @param Capture The capture, or null to stop capturing.
+   */
+  void SetCapture(std::shared_ptr<CQueryCapture> Capture)
+  {
+    m_Capture = Capture;
+  }
 
-    if (lower == m_CalibratedMap.end() || upper == m_CalibratedMap.end())
-      throw std::out_of_range("Nominal value outside of calibrated range.");
+  /**
+   * @brief Gets the query capture.
+   * @return The capture, or null if queries are not being captured.
+   */
+  std::shared_ptr<CQueryCapture> GetCapture()
+  {
+    return m_Capture;
+  }
 
-    return Interpolate(Nominal, lower->first, lower->second, upper->first, upper->second);
+  /**
+   * @brief Sets how close a nominal value must be to a breakpoint to count as an exact hit.
+   *
+   * A nominal value within the tolerance snaps to the nearer of its two neighbouring
+   * breakpoints and returns that breakpoint's stored error, so the result can differ
+   * from interpolation by at most the segment slope times the tolerance. The range
+   * is also extended by the tolerance at both ends. The default of zero snaps only
+   * exact matches.
+   * @param Tolerance The snap distance in nominal units.
+   * @throws std::invalid_argument if the tolerance is negative or not finite.
+   */
+  void SetSnapTolerance(double Tolerance)
+  {
+    if (!(Tolerance >= 0.0) || std::isinf(Tolerance))
+      throw std::invalid_argument("Snap tolerance must be a finite, non-negative value.");
+    m_SnapTolerance = Tolerance;
+    NewVersion();
+  }
+
+  /**
+   * @brief Gets the snap tolerance.
+   * @return The snap distance in nominal units.
+   */
+  double GetSnapTolerance()
+  {
+    return m_SnapTolerance;
   }
 
   /**
@@ -105,7 +662,271 @@ public:
    */
   double CorrectedPoint(double Nominal)
   {
-    return Nominal - ErrorValue(Nominal);
+    if (!m_Cache)
+      return Nominal - ErrorValue(Nominal);
+
+    double Corrected;
+    if (m_Cache->Find(Nominal, m_Version, Corrected))
+    {
+      if (m_Capture)
+        m_Capture->Record(Nominal);
+      return Corrected;
+    }
+    Corrected = Nominal - ErrorValue(Nominal);
+    m_Cache->Store(Nominal, m_Version, Corrected);
+    return Corrected;
+  }
+
+  /**
+   * @brief Places a cache of corrected points in front of CorrectedPoint().
+   *
+   * Worthwhile when the same exact nominal values recur, such as indexer or tool
+   * changer positions. Any change to the map, its snap tolerance or its frozen
+   * state invalidates the cached values. Copies share the cache, which is safe
+   * because map versions are unique across all maps.
+   * @param Entries Number of slots, rounded up to a power of two; zero removes the cache.
+   */
+  void EnableCache(size_t Entries)
+  {
+    m_Cache = Entries ? std::make_shared<CCorrectionCache>(Entries) : nullptr;
+  }
+
+  /**
+   * @brief Gets the cache hit and miss counts.
+   * @return The counts, or zeros if no cache is enabled.
+   */
+  CCorrectionCache::Stats GetCacheStats()
+  {
+    return m_Cache ? m_Cache->GetStats() : CCorrectionCache::Stats();
+  }
+
+  /**
+   * @brief Resets the cache hit and miss counts.
+   */
+  void ResetCacheStats()
+  {
+    if (m_Cache)
+      m_Cache->ResetStats();
+  }
+
+  /**
+   * @brief Retrieves the error value using a caller-held search cursor.
+   *
+   * On a frozen map the cursor remembers the last segment, so sorted or slowly
+   * varying inputs are found in constant time and other inputs fall back to a
+   * binary search. Unfrozen maps ignore the cursor.
+   * @param Nominal The nominal value.
+   * @param Cursor Segment hint, updated to the segment containing Nominal. Start with zero.
+   * @return The error value from the calibration map.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::out_of_range if the nominal value is outside the map range.
+   */
+  double ErrorValueAt(double Nominal, size_t& Cursor)
+  {
+    if (m_Capture)
+      m_Capture->Record(Nominal);
+    if (const FrozenTable* Table = CurrentTable())
+      return Table->ErrorValue(Nominal, Cursor, m_SnapTolerance);
+    return TreeErrorValue(Nominal);
+  }
+
+  /**
+   * @brief Retrieves error values for a batch of nominal inputs.
+   * @param Nominals View of Count nominal values.
+   * @param Errors View receiving Count error values. It may alias Nominals.
+   * @param Count Number of values.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::out_of_range if a nominal value is outside the map range. Earlier outputs are already written.
+   */
+  void ErrorValues(CStridedArray<const double> Nominals, CStridedArray<double> Errors, size_t Count)
+  {
+    size_t Cursor = 0;
+    for (size_t i = 0; i < Count; ++i)
+      Errors[i] = ErrorValueAt(Nominals[i], Cursor);
+  }
+
+  /**
+   * @brief Computes corrected points for a batch of nominal inputs.
+   *
+   * Both views may point into arrays of larger records, so positions can be
+   * corrected in place without copying them out first.
+   * @param Nominals View of Count nominal values.
+   * @param Corrected View receiving Count corrected points. It may alias Nominals.
+   * @param Count Number of values.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::out_of_range if a nominal value is outside the map range. Earlier outputs are already written.
+   */
+  void CorrectedPoints(CStridedArray<const double> Nominals, CStridedArray<double> Corrected, size_t Count)
+  {
+    size_t Cursor = 0;
+    for (size_t i = 0; i < Count; ++i)
+    {
+      double Nominal = Nominals[i];
+      Corrected[i] = Nominal - ErrorValueAt(Nominal, Cursor);
+    }
+  }
+
+  /**
+   * @brief Builds a flat, sorted lookup table from the calibration map.
+   *
+   * While frozen, ErrorValue() and CorrectedPoint() binary search the flat table
+   * instead of walking the tree. Runs of collinear segments can be merged so they
+   * no longer cost search depth. Any change to the map thaws it again.
+   *
+   * Given an error budget, the table is evaluated with float and double errors at
+   * every breakpoint and segment midpoint, and float storage is chosen if the worst
+   * deviation stays within the budget.
+   * @param Options Merge strategy, tolerance and error budget.
+   * @return The number of breakpoints before and after merging and the storage chosen.
+   * @throws std::invalid_argument if the merge tolerance or error budget is negative or not finite.
+   */
+  FreezeReport Freeze(const FreezeOptions& Options)
+  {
+    ValidateFreezeOptions(Options);
+    FreezeReport Report;
+    Publish(BuildTable(Options, Report));
+    m_FreezeOptions = Options;
+    NewVersion();
+    return Report;
+  }
+
+  /**
+   * @brief Builds the frozen lookup table without merging any segments.
+   * @return The number of breakpoints before and after freezing.
+   */
+  FreezeReport Freeze()
+  {
+    return Freeze(FreezeOptions());
+  }
+
+  /**
+   * @brief Freezes the map automatically on the first lookup after a change.
+   *
+   * Edits leave the map dirty, and the next lookup builds the table with the given
+   * options before answering. Concurrent readers are safe: one of them builds the
+   * table while the others wait, and a table is only published once complete.
+   * The options are kept apart from those of Freeze(), so an explicit freeze does
+   * not change later lazy builds.
+   * @param Enabled True to freeze lazily.
+   * @param Options Merge strategy, tolerance and error budget for lazy builds.
+   * @throws std::invalid_argument if the merge tolerance or error budget is negative or not finite.
+   */
+  void SetLazyFreeze(bool Enabled, const FreezeOptions& Options)
+  {
+    ValidateFreezeOptions(Options);
+    m_LazyFreezeOptions = Options;
+    m_LazyFreeze = Enabled;
+  }
+
+  /**
+   * @brief Freezes the map automatically on the first lookup after a change, without merging segments.
+   * @param Enabled True to freeze lazily.
+   */
+  void SetLazyFreeze(bool Enabled)
+  {
+    SetLazyFreeze(Enabled, FreezeOptions());
+  }
+
+  /**
+   * @brief Indicates whether the map freezes automatically on lookup.
+   * @return True if lazy freezing is enabled.
+   */
+  bool GetLazyFreeze()
+  {
+    return m_LazyFreeze;
+  }
+
+  /**
+   * @brief Gets the options used by lazy builds.
+   * @return The lazy freeze options.
+   */
+  const FreezeOptions& GetLazyFreezeOptions()
+  {
+    return m_LazyFreezeOptions;
+  }
+
+  /**
+   * @brief Builds the frozen table on a background thread, using the options of the most recent Freeze().
+   *
+   * Lookups keep using the tree until the table is published. Publishing keeps the
+   * cache version, so with float storage a value cached from the tree may differ
+   * from a fresh table lookup by up to the error budget. The map must not be
+   * modified or destroyed until the returned future is ready.
+   * @return A future that becomes ready once the table is published.
+   */
+  std::future<void> FreezeAsync()
+  {
+    FreezeOptions Options = m_FreezeOptions;
+    return std::async(std::launch::async, [this, Options]() { CompileTable(Options); });
+  }
+
+  /**
+   * @brief Releases the frozen lookup table and returns to tree lookups.
+   *
+   * The table's memory is freed once no copy of the map shares it.
+   */
+  void Thaw()
+  {
+    Publish(nullptr);
+    NewVersion();
+  }
+
+  /**
+   * @brief Gets the frozen lookup table.
+   * @return The table; empty unless the map is frozen.
+   */
+  const FrozenTable& GetFrozenTable()
+  {
+    static const FrozenTable Empty;
+    const FrozenTable* Table = m_Table.Pointer.load(std::memory_order_acquire);
+    return Table ? *Table : Empty;
+  }
+
+  /**
+   * @brief Gets the options used by the most recent Freeze().
+   * @return The freeze options.
+   */
+  const FreezeOptions& GetFreezeOptions()
+  {
+    return m_FreezeOptions;
+  }
+
+  /**
+   * @brief Indicates whether lookups use the frozen table.
+   * @return True if the map is frozen; false while a lazily frozen map is dirty.
+   */
+  bool IsFrozen()
+  {
+    return m_Table.Pointer.load(std::memory_order_acquire) != nullptr;
+  }
+
+  /**
+   * @brief Indicates whether this map and another share their breakpoint tree.
+   * @param Other The other map.
+   * @return True if neither map has been modified since one was copied from the other.
+   */
+  bool SharesStorageWith(const CCalibrationMap& Other)
+  {
+    return m_CalibratedMap == Other.m_CalibratedMap;
+  }
+
+  /**
+   * @brief Reports the memory used by the tree and the frozen table.
+   *
+   * Storage shared with copies is counted in full by each of them. Safe to call
+   * while a lazy or background build is publishing the table.
+   * @return Bytes per representation.
+   */
+  CMemoryFootprint MemoryFootprint()
+  {
+    CMemoryFootprint Footprint;
+    Footprint.TreeBytes = sizeof(std::map<double, double>)
+      + m_CalibratedMap->size() * CMemoryFootprint::TreeNodeBytes<std::map<double, double>::value_type>();
+    // Lazy and background builds may publish concurrently, so read the published pointer.
+    const FrozenTable* Table = m_Table.Pointer.load(std::memory_order_acquire);
+    Footprint.FrozenBytes = Table ? Table->Bytes() : 0;
+    Footprint.CacheBytes = m_Cache ? m_Cache->Bytes() : 0;
+    return Footprint;
   }
 
   /**
@@ -116,7 +937,8 @@ public:
   {
     std::ostringstream summary;
     summary << "Nominal\tCalibrated\tError\tCorrected\n";
-    for (auto it = m_CalibratedMap.begin(); it != m_CalibratedMap.end(); ++it)
+    const std::map<double, double>& Points = *m_CalibratedMap;
+    for (auto it = Points.begin(); it != Points.end(); ++it)
       summary << it->first << "\t" << it->first - ErrorValue(it->first) << "\t\t"
       << ErrorValue(it->first) << "\t" << CorrectedPoint(it->first) << "\n";
     return summary.str();
@@ -124,9 +946,374 @@ public:
 
 private:
   /**
-   * @brief Holds the calibration error values.
+   * @brief Holds the calibration error values, shared with copies until modified.
+   */
+  std::shared_ptr<std::map<double, double>> m_CalibratedMap = EmptyMap();
+
+  /**
+   * @brief Copyable atomic pointer to the table lookups use.
+   */
+  struct CPublishedTable
+  {
+    std::atomic<const FrozenTable*> Pointer{ nullptr };
+
+    CPublishedTable() = default;
+
+    CPublishedTable(const CPublishedTable& Other)
+      : Pointer(Other.Pointer.load(std::memory_order_acquire))
+    {
+    }
+
+    CPublishedTable& operator=(const CPublishedTable& Other)
+    {
+      Pointer.store(Other.Pointer.load(std::memory_order_acquire), std::memory_order_release);
+      return *this;
+    }
+  };
+
+  /**
+   * @brief Serialises lazy and background builds of one map. Each copy has its own.
    */
-  std::map<double, double> m_CalibratedMap;
+  struct CCompileLock
+  {
+    std::mutex Mutex;
+
+    CCompileLock() = default;
+
+    CCompileLock(const CCompileLock&)
+    {
+    }
+
+    CCompileLock& operator=(const CCompileLock&)
+    {
+      return *this;
+    }
+  };
+
+  /**
+   * @brief The frozen lookup table, shared with copies; null unless frozen.
+   */
+  std::shared_ptr<const FrozenTable> m_Frozen;
+
+  /**
+   * @brief The table lookups use, published once complete; owned by m_Frozen.
+   */
+  CPublishedTable m_Table;
+
+  /**
+   * @brief True to build the table on the first lookup after a change.
+   */
+  bool m_LazyFreeze = false;
+
+  /**
+   * @brief Options for lazy builds.
+   */
+  FreezeOptions m_LazyFreezeOptions;
+
+  /**
+   * @brief Guards building the table on demand.
+   */
+  CCompileLock m_CompileLock;
+
+  /**
+   * @brief Optional capture of queried nominal values, shared with copies.
+   */
+  std::shared_ptr<CQueryCapture> m_Capture;
+
+  /**
+   * @brief Optional cache of corrected points, shared with copies.
+   */
+  std::shared_ptr<CCorrectionCache> m_Cache;
+
+  /**
+   * @brief Identifies the map's current contents and lookup settings for the cache.
+   */
+  uint64_t m_Version = NextVersion();
+
+  /**
+   * @brief Options used by the most recent Freeze().
+   */
+  FreezeOptions m_FreezeOptions;
+
+  /**
+   * @brief Distance within which a nominal value snaps to a breakpoint.
+   */
+  double m_SnapTolerance = 0.0;
+
+  /**
+   * @brief Searches the tree for the error value.
+   * @param Nominal The nominal value.
+   * @return The error value from the calibration map.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::out_of_range if the nominal value is outside the map range.
+   */
+  double TreeErrorValue(double Nominal)
+  {
+    const std::map<double, double>& Points = *m_CalibratedMap;
+    if (Points.empty())
+      throw std::runtime_error("Calibration map is empty.");
+
+    auto upper = Points.upper_bound(Nominal);
+    auto lower = (upper == Points.begin()) ? Points.end() : std::prev(upper);
+
+    double Below = lower != Points.end() ? Nominal - lower->first : std::numeric_limits<double>::infinity();
+    double Above = upper != Points.end() ? upper->first - Nominal : std::numeric_limits<double>::infinity();
+    if (Below <= Above)
+    {
+      if (Below <= m_SnapTolerance)
+        return lower->second;
+    }
+    else if (Above <= m_SnapTolerance)
+      return upper->second;
+
+    if (lower == Points.end() || upper == Points.end())
+      throw std::out_of_range("Nominal value outside of calibrated range.");
+
+    return Interpolate(Nominal, lower->first, lower->second, upper->first, upper->second);
+  }
+
+  /**
+   * @brief Checks freeze options before they are used.
+   * @param Options The options.
+   * @throws std::invalid_argument if the merge tolerance or error budget is negative or not finite.
+   */
+  static void ValidateFreezeOptions(const FreezeOptions& Options)
+  {
+    if (!(Options.Tolerance >= 0.0) || std::isinf(Options.Tolerance))
+      throw std::invalid_argument("Merge tolerance must be a finite, non-negative value.");
+    if (!(Options.ErrorBudget >= 0.0) || std::isinf(Options.ErrorBudget))
+      throw std::invalid_argument("Error budget must be a finite, non-negative value.");
+  }
+
+  /**
+   * @brief Builds a frozen table from the tree.
+   * @param Options Merge strategy, tolerance and error budget.
+   * @param Report Receives the breakpoint counts and storage chosen.
+   * @return The table.
+   */
+  std::shared_ptr<const FrozenTable> BuildTable(const FreezeOptions& Options, FreezeReport& Report)
+  {
+    const std::map<double, double>& Points = *m_CalibratedMap;
+    std::vector<double> Nominals;
+    std::vector<double> Errors;
+    Nominals.reserve(Points.size());
+    Errors.reserve(Points.size());
+    for (auto it = Points.begin(); it != Points.end(); ++it)
+    {
+      Nominals.push_back(it->first);
+      Errors.push_back(it->second);
+    }
+
+    if (Options.Merge != MergeMode::None)
+      MergeCollinear(Nominals, Errors, Options);
+
+    Report.SourcePoints = Points.size();
+    Report.FrozenPoints = Nominals.size();
+
+    std::vector<float> FloatErrors;
+    if (Options.ErrorBudget > 0.0)
+    {
+      FloatErrors.assign(Errors.begin(), Errors.end());
+      Report.FloatDeviation = FloatDeviation(Nominals, Errors, FloatErrors);
+      if (Report.FloatDeviation <= Options.ErrorBudget)
+      {
+        Report.Storage = StorageType::Float;
+        std::vector<double>().swap(Errors);
+      }
+      else
+        std::vector<float>().swap(FloatErrors);
+    }
+
+    std::shared_ptr<FrozenTable> Table = std::make_shared<FrozenTable>();
+    Table->Nominals.swap(Nominals);
+    Table->Errors.swap(Errors);
+    Table->FloatErrors.swap(FloatErrors);
+    Table->Storage = Report.Storage;
+    return Table;
+  }
+
+  /**
+   * @brief Makes a table the one used by lookups.
+   * @param Table The table, or null to return to tree lookups.
+   */
+  void Publish(std::shared_ptr<const FrozenTable> Table)
+  {
+    m_Frozen = Table;
+    m_Table.Pointer.store(Table.get(), std::memory_order_release);
+  }
+
+  /**
+   * @brief Gets the table lookups should use, building it first if lazy freezing is due.
+   * @return The table, or null to search the tree.
+   */
+  const FrozenTable* CurrentTable()
+  {
+    const FrozenTable* Table = m_Table.Pointer.load(std::memory_order_acquire);
+    if (Table == nullptr && m_LazyFreeze)
+      Table = CompileTable(m_LazyFreezeOptions);
+    return Table;
+  }
+
+  /**
+   * @brief Builds and publishes the table unless another thread already has.
+   * @param Options Merge strategy, tolerance and error budget.
+   * @return The published table.
+   */
+  const FrozenTable* CompileTable(const FreezeOptions& Options)
+  {
+    std::lock_guard<std::mutex> Guard(m_CompileLock.Mutex);
+    const FrozenTable* Table = m_Table.Pointer.load(std::memory_order_acquire);
+    if (Table == nullptr)
+    {
+      FreezeReport Report;
+      std::shared_ptr<const FrozenTable> Built = BuildTable(Options, Report);
+      Table = Built.get();
+      Publish(Built);
+    }
+    return Table;
+  }
+
+  /**
+   * @brief Draws a version number no map has used before.
+   * @return The new version, never zero.
+   */
+  static uint64_t NextVersion()
+  {
+    static std::atomic<uint64_t> Counter{ 0 };
+    return Counter.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  /**
+   * @brief Gives the map a new version, invalidating cached corrections.
+   */
+  void NewVersion()
+  {
+    m_Version = NextVersion();
+  }
+
+  /**
+   * @brief Gets the tree shared by default-constructed maps.
+   * @return The empty tree.
+   */
+  static const std::shared_ptr<std::map<double, double>>& EmptyMap()
+  {
+    static const std::shared_ptr<std::map<double, double>> Empty = std::make_shared<std::map<double, double>>();
+    return Empty;
+  }
+
+  /**
+   * @brief Thaws the map and gets a tree it may modify, cloning the tree if it is shared.
+   * @return The tree owned by this map alone.
+   */
+  std::map<double, double>& MutableMap()
+  {
+    Thaw();
+    if (m_CalibratedMap.use_count() != 1)
+      m_CalibratedMap = std::make_shared<std::map<double, double>>(*m_CalibratedMap);
+    return *m_CalibratedMap;
+  }
+
+  /**
+   * @brief Measures how far float errors move the interpolated result.
+   * @param Nominals Sorted nominal values.
+   * @param Errors Matching error values.
+   * @param FloatErrors The same errors rounded to float.
+   * @return The worst deviation at any breakpoint or segment midpoint.
+   */
+  double FloatDeviation(const std::vector<double>& Nominals, const std::vector<double>& Errors,
+    const std::vector<float>& FloatErrors)
+  {
+    double Worst = 0.0;
+    for (size_t i = 0; i < Nominals.size(); ++i)
+    {
+      Worst = std::max(Worst, std::fabs(static_cast<double>(FloatErrors[i]) - Errors[i]));
+      if (i + 1 == Nominals.size())
+        break;
+
+      double Middle = Nominals[i] + (Nominals[i + 1] - Nominals[i]) / 2.0;
+      double Exact = Interpolate(Middle, Nominals[i], Errors[i], Nominals[i + 1], Errors[i + 1]);
+      double Rounded = Interpolate(Middle, Nominals[i], FloatErrors[i], Nominals[i + 1], FloatErrors[i + 1]);
+      Worst = std::max(Worst, std::fabs(Rounded - Exact));
+    }
+    return Worst;
+  }
+
+  /**
+   * @brief Removes breakpoints that lie on the segment joining their neighbours.
+   *
+   * Each run is first extended greedily while the chord from its anchor stays inside
+   * the slope window allowed by every skipped breakpoint, which keeps the pass linear.
+   * The candidate run is then verified with Interpolate() itself and halved until it
+   * passes, so the merged table never exceeds the requested deviation.
+   * @param Nominals Sorted nominal values, replaced by the kept breakpoints.
+   * @param Errors Matching error values, replaced by the kept breakpoints.
+   * @param Options Merge strategy and tolerance.
+   */
+  void MergeCollinear(std::vector<double>& Nominals, std::vector<double>& Errors, const FreezeOptions& Options)
+  {
+    size_t Count = Nominals.size();
+    if (Count < 3)
+      return;
+
+    std::vector<double> KeptNominals(1, Nominals[0]);
+    std::vector<double> KeptErrors(1, Errors[0]);
+
+    size_t Anchor = 0;
+    while (Anchor < Count - 1)
+    {
+      double Low = -std::numeric_limits<double>::infinity();
+      double High = std::numeric_limits<double>::infinity();
+      size_t End = Anchor + 1;
+
+      for (size_t k = Anchor + 1; k < Count; ++k)
+      {
+        double Run = Nominals[k] - Nominals[Anchor];
+        double Slope = (Errors[k] - Errors[Anchor]) / Run;
+        if (Slope < Low || Slope > High)
+          break;
+        End = k;
+
+        double Slack = Options.Merge == MergeMode::ExactAtBreakpoints
+          ? 64.0 * DBL_EPSILON * (std::fabs(Errors[k]) + std::fabs(Errors[Anchor]))
+          : Options.Tolerance;
+        Low = std::max(Low, (Errors[k] - Slack - Errors[Anchor]) / Run);
+        High = std::min(High, (Errors[k] + Slack - Errors[Anchor]) / Run);
+      }
+
+      while (End > Anchor + 1 && !IsMergeable(Nominals, Errors, Anchor, End, Options))
+        End = Anchor + 1 + (End - Anchor - 1) / 2;
+
+      KeptNominals.push_back(Nominals[End]);
+      KeptErrors.push_back(Errors[End]);
+      Anchor = End;
+    }
+
+    KeptNominals.shrink_to_fit();
+    KeptErrors.shrink_to_fit();
+    Nominals.swap(KeptNominals);
+    Errors.swap(KeptErrors);
+  }
+
+  /**
+   * @brief Checks whether the breakpoints strictly between First and Last can be removed.
+   * @param Nominals Sorted nominal values.
+   * @param Errors Matching error values.
+   * @param First Index of the breakpoint starting the merged segment.
+   * @param Last Index of the breakpoint ending the merged segment.
+   * @param Options Merge strategy and tolerance.
+   * @return True if every skipped breakpoint is reproduced by the merged segment.
+   */
+  bool IsMergeable(const std::vector<double>& Nominals, const std::vector<double>& Errors,
+    size_t First, size_t Last, const FreezeOptions& Options)
+  {
+    for (size_t i = First + 1; i < Last; ++i)
+    {
+      double Merged = Interpolate(Nominals[i], Nominals[First], Errors[First], Nominals[Last], Errors[Last]);
+      if (Options.Merge == MergeMode::ExactAtBreakpoints ? Merged != Errors[i] : !(std::fabs(Merged - Errors[i]) <= Options.Tolerance))
+        return false;
+    }
+    return true;
+  }
 
   /**
    * @brief Performs linear interpolation between two points.
@@ -137,7 +1324,7 @@ private:
    * @param y2 The second known y-value.
    * @return The interpolated y-value.
    */
-  double Interpolate(double x, double x1, double y1, double x2, double y2)
+  static double Interpolate(double x, double x1, double y1, double x2, double y2)
   {
     return y1 + (x - x1) * (y2 - y1) / (x2 - x1);
   }
@@ -0,0 +1,170 @@
+/**
+ * @file CCalibrationPatch.h
+ * @brief Defines the CCalibrationPatch class, a binary delta format for map updates.
+ *
+ * Recalibrations usually change a small fraction of points. A patch carries only
+ * the changed breakpoints, together with checksums of the map it applies to and of
+ * the map it produces, so it can be shipped instead of the whole file and applied
+ * in place.
+ *
+ * Layout: the magic "CPAT", a 32-bit version, the base and target map checksums
+ * (CCalibrationFile::MapChecksum), a 64-bit operation count, the operations and a
+ * CRC-32 of everything before it. An operation is a type byte followed by the
+ * nominal value and, for a set, the error value.
+ */
+
+#pragma once
+#include "CCalibrationDiff.h"
+#include "CCalibrationFile.h"
+
+/**
+ * @class CCalibrationPatch
+ * @brief Creates and applies binary delta patches.
+ */
+class CCalibrationPatch
+{
+public:
+  /**
+   * @brief Creates a patch turning one map into another.
+   * @param Old The deployed map.
+   * @param New The updated map.
+   * @return The patch bytes.
+   */
+  static std::string Create(CCalibrationMap& Old, CCalibrationMap& New)
+  {
+    CCalibrationDiff Diff = CCalibrationDiff::Compute(Old, New);
+
+    std::ostringstream Out;
+    Out.write(Magic, sizeof(Magic));
+    CCalibrationFile::WriteValue(Out, Version);
+    CCalibrationFile::WriteValue(Out, CCalibrationFile::MapChecksum(Old));
+    CCalibrationFile::WriteValue(Out, CCalibrationFile::MapChecksum(New));
+    CCalibrationFile::WriteValue(Out, static_cast<uint64_t>(Diff.Removed.size() + Diff.Added.size() + Diff.Changed.size()));
+
+    for (size_t i = 0; i < Diff.Removed.size(); ++i)
+    {
+      CCalibrationFile::WriteValue(Out, RemoveOperation);
+      CCalibrationFile::WriteValue(Out, Diff.Removed[i].first);
+    }
+    for (size_t i = 0; i < Diff.Added.size(); ++i)
+    {
+      CCalibrationFile::WriteValue(Out, SetOperation);
+      CCalibrationFile::WriteValue(Out, Diff.Added[i].first);
+      CCalibrationFile::WriteValue(Out, Diff.Added[i].second);
+    }
+    for (size_t i = 0; i < Diff.Changed.size(); ++i)
+    {
+      CCalibrationFile::WriteValue(Out, SetOperation);
+      CCalibrationFile::WriteValue(Out, Diff.Changed[i].Nominal);
+      CCalibrationFile::WriteValue(Out, Diff.Changed[i].NewError);
+    }
+
+    std::string Patch = Out.str();
+    uint32_t Crc = CCalibrationFile::Crc32(Patch.data(), Patch.size());
+    Patch.append(reinterpret_cast<const char*>(&Crc), sizeof(Crc));
+    return Patch;
+  }
+
+  /**
+   * @brief Applies a patch to a map in place.
+   *
+   * The patch and the base map are verified before any change is made. If the
+   * result does not match the target checksum, the changes are rolled back. A map
+   * that was frozen is frozen again with its previous options.
+   * @param Patch The patch bytes.
+   * @param Map The map to update.
+   * @throws std::runtime_error if the patch is corrupt, was made for a different map or produces the wrong result.
+   */
+  static void Apply(const std::string& Patch, CCalibrationMap& Map)
+  {
+    const size_t HeaderSize = sizeof(Magic) + sizeof(Version) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+    if (Patch.size() < HeaderSize + sizeof(uint32_t) || Patch.compare(0, sizeof(Magic), Magic, sizeof(Magic)) != 0)
+      throw std::runtime_error("Not a calibration patch.");
+
+    uint32_t Crc;
+    std::memcpy(&Crc, Patch.data() + Patch.size() - sizeof(Crc), sizeof(Crc));
+    if (Crc != CCalibrationFile::Crc32(Patch.data(), Patch.size() - sizeof(Crc)))
+      throw std::runtime_error("Calibration patch failed its checksum.");
+
+    std::istringstream In(Patch.substr(sizeof(Magic), Patch.size() - sizeof(Magic) - sizeof(Crc)));
+    uint32_t PatchVersion;
+    uint32_t BaseChecksum;
+    uint32_t TargetChecksum;
+    uint64_t Count;
+    CCalibrationFile::ReadValue(In, PatchVersion);
+    CCalibrationFile::ReadValue(In, BaseChecksum);
+    CCalibrationFile::ReadValue(In, TargetChecksum);
+    CCalibrationFile::ReadValue(In, Count);
+    if (PatchVersion != Version)
+      throw std::runtime_error("Unsupported calibration patch version.");
+    if (CCalibrationFile::MapChecksum(Map) != BaseChecksum)
+      throw std::runtime_error("Calibration patch does not apply to this map.");
+
+    std::vector<COperation> Operations;
+    for (uint64_t i = 0; i < Count; ++i)
+    {
+      COperation Operation = COperation();
+      CCalibrationFile::ReadValue(In, Operation.Type);
+      CCalibrationFile::ReadValue(In, Operation.Nominal);
+      if (Operation.Type == SetOperation)
+        CCalibrationFile::ReadValue(In, Operation.Error);
+      else if (Operation.Type != RemoveOperation)
+        throw std::runtime_error("Calibration patch contains an unknown operation.");
+      if (!In)
+        throw std::runtime_error("Calibration patch is truncated.");
+      Operations.push_back(Operation);
+    }
+
+    // A lazily frozen map rebuilds with its own options on the next lookup.
+    bool WasFrozen = Map.IsFrozen() && !Map.GetLazyFreeze();
+    CCalibrationMap::FreezeOptions Options = Map.GetFreezeOptions();
+
+    std::vector<COperation> Undo;
+    Undo.reserve(Operations.size());
+    const std::map<double, double>& Points = Map.GetMap();
+    for (size_t i = 0; i < Operations.size(); ++i)
+    {
+      auto Existing = Points.find(Operations[i].Nominal);
+      Undo.push_back(Existing == Points.end()
+        ? COperation { RemoveOperation, Operations[i].Nominal, 0.0 }
+        : COperation { SetOperation, Operations[i].Nominal, Existing->second });
+      Execute(Operations[i], Map);
+    }
+
+    if (CCalibrationFile::MapChecksum(Map) != TargetChecksum)
+    {
+      for (size_t i = Undo.size(); i-- > 0;)
+        Execute(Undo[i], Map);
+      if (WasFrozen)
+        Map.Freeze(Options);
+      throw std::runtime_error("Patched calibration map does not match the target checksum.");
+    }
+
+    if (WasFrozen)
+      Map.Freeze(Options);
+  }
+
+private:
+  /**
+   * @brief A decoded patch operation.
+   */
+  struct COperation
+  {
+    uint8_t Type;
+    double Nominal;
+    double Error;
+  };
+
+  static constexpr char Magic[4] = { 'C', 'P', 'A', 'T' };
+  static constexpr uint32_t Version = 1;
+  static constexpr uint8_t SetOperation = 1;
+  static constexpr uint8_t RemoveOperation = 2;
+
+  static void Execute(const COperation& Operation, CCalibrationMap& Map)
+  {
+    if (Operation.Type == SetOperation)
+      Map.SetErrorValue(Operation.Nominal, Operation.Error);
+    else
+      Map.RemovePoint(Operation.Nominal);
+  }
+};
@@ -0,0 +1,410 @@
+/**
+ * @file CCalibrationRegistry.h
+ * @brief Defines the CCalibrationRegistry class, a concurrent bank of maps keyed by channel ID.
+ *
+ * Control loops look up the map for a channel on every cycle. The registry keeps
+ * each channel in a slot that never moves, indexed by an open-addressing table of
+ * atomic slot pointers: lookups never lock, and a handle to a channel's slot stays
+ * valid for the registry's lifetime, so hot paths can resolve a channel once and
+ * read its current map with two atomic loads.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * @class CCalibrationRegistry
+ * @brief Lock-free-read registry of calibration maps keyed by channel ID.
+ *
+ * Registration and replacement are serialised by a mutex and publish the new map
+ * with a release store. A replaced map is retired rather than deleted, because
+ * readers may still be using it; ReclaimRetired() frees retired maps once the
+ * caller knows no reader holds an old pointer (for example after every control
+ * thread has passed the end of its cycle).
+ *
+ * Removing a channel frees its slot for later registrations and leaves a tombstone
+ * in the index. Once tombstones fill a quarter of the index it is rebuilt from the
+ * live slots and republished; the old index is retired like a replaced map.
+ *
+ * Readers share the registered maps, so they may only call lookups such as
+ * ErrorValue(), which are safe to run concurrently. Editing methods (AddPoint(),
+ * SetMap(), Freeze() and the like) must never be called on a registered map;
+ * register an edited copy instead.
+ */
+class CCalibrationRegistry
+{
+private:
+  /**
+   * @brief One channel's slot. Slots never move; a freed slot is reused by a later channel.
+   */
+  struct CSlot
+  {
+    std::atomic<uint64_t> Channel;
+    std::atomic<CCalibrationMap*> Map;
+  };
+
+  /**
+   * @brief Open-addressing index from channel to slot.
+   *
+   * Readers follow Entries and compare the slot's channel, so an entry left behind
+   * by a removed channel only lengthens probes. Keys is private to the writer; a
+   * tombstone is an entry with a slot whose key is EmptyChannel.
+   */
+  struct CIndex
+  {
+    size_t Mask = 0;
+    std::unique_ptr<std::atomic<CSlot*>[]> Entries;
+    std::unique_ptr<uint64_t[]> Keys;
+
+    explicit CIndex(size_t Size)
+      : Mask(Size - 1), Entries(new std::atomic<CSlot*>[Size]), Keys(new uint64_t[Size])
+    {
+      for (size_t i = 0; i < Size; ++i)
+      {
+        Entries[i].store(nullptr, std::memory_order_relaxed);
+        Keys[i] = EmptyChannel;
+      }
+    }
+  };
+
+public:
+  /**
+   * @class CHandle
+   * @brief Stable reference to a channel's slot.
+   */
+  class CHandle
+  {
+  public:
+    CHandle() = default;
+
+    /**
+     * @brief Gets the channel's current map.
+     *
+     * The map may only be used for lookups; see CCalibrationRegistry.
+     * @return The map, or nullptr if the channel has been removed.
+     */
+    CCalibrationMap* Get() const
+    {
+      CCalibrationMap* Map = m_Slot->Map.load(std::memory_order_acquire);
+      if (m_Slot->Channel.load(std::memory_order_acquire) != m_Channel)
+        return nullptr;
+      return Map;
+    }
+
+    /**
+     * @brief Indicates whether the handle refers to a channel.
+     * @return True if the channel was found.
+     */
+    explicit operator bool() const
+    {
+      return m_Slot != nullptr;
+    }
+
+  private:
+    friend class CCalibrationRegistry;
+
+    CHandle(CSlot* Slot, uint64_t Channel)
+      : m_Slot(Slot), m_Channel(Channel)
+    {
+    }
+
+    /**
+     * @brief The channel's slot.
+     */
+    CSlot* m_Slot = nullptr;
+
+    /**
+     * @brief The channel, checked against the slot's key in case the slot was reused.
+     */
+    uint64_t m_Channel = 0;
+  };
+
+  /**
+   * @brief Creates a registry.
+   * @param Capacity Maximum number of channels. The index is sized to keep probes short.
+   */
+  explicit CCalibrationRegistry(size_t Capacity = 1024)
+  {
+    m_IndexSize = 16;
+    while (m_IndexSize < 2 * Capacity)
+      m_IndexSize <<= 1;
+    m_Capacity = Capacity;
+    m_Slots.reset(new CSlot[Capacity]);
+    for (size_t i = 0; i < Capacity; ++i)
+    {
+      m_Slots[i].Channel.store(EmptyChannel, std::memory_order_relaxed);
+      m_Slots[i].Map.store(nullptr, std::memory_order_relaxed);
+      m_FreeSlots.push_back(Capacity - 1 - i);
+    }
+    m_CurrentIndex.reset(new CIndex(m_IndexSize));
+    m_Index.store(m_CurrentIndex.get(), std::memory_order_relaxed);
+  }
+
+  CCalibrationRegistry(const CCalibrationRegistry&) = delete;
+  CCalibrationRegistry& operator=(const CCalibrationRegistry&) = delete;
+
+  ~CCalibrationRegistry()
+  {
+    for (size_t i = 0; i < m_Capacity; ++i)
+      delete m_Slots[i].Map.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Registers or replaces the map for a channel.
+   * @param Channel The channel ID.
+   * @param Map The calibration map, frozen beforehand if fast lookups are wanted.
+   * @return A handle to the channel's slot.
+   * @throws std::invalid_argument if Channel is the reserved value UINT64_MAX.
+   * @throws std::length_error if the registry is full.
+   */
+  CHandle Register(uint64_t Channel, CCalibrationMap Map)
+  {
+    if (Channel == EmptyChannel)
+      throw std::invalid_argument("Channel ID is reserved.");
+
+    std::unique_ptr<CCalibrationMap> Owned(new CCalibrationMap(std::move(Map)));
+    std::lock_guard<std::mutex> Lock(m_WriteMutex);
+
+    size_t Entry = Probe(*m_CurrentIndex, Channel);
+    if (m_CurrentIndex->Keys[Entry] == Channel)
+    {
+      CSlot* Slot = m_CurrentIndex->Entries[Entry].load(std::memory_order_relaxed);
+      Retire(Slot->Map.exchange(Owned.release(), std::memory_order_acq_rel));
+      return CHandle(Slot, Channel);
+    }
+
+    if (m_FreeSlots.empty())
+      throw std::length_error("Calibration registry is full.");
+    if (IsEmpty(*m_CurrentIndex, Entry) && m_Claimed + 1 > m_IndexSize - m_IndexSize / 4)
+    {
+      Rebuild();
+      Entry = Probe(*m_CurrentIndex, Channel);
+    }
+
+    CSlot* Slot = &m_Slots[m_FreeSlots.back()];
+    m_FreeSlots.pop_back();
+    // The key goes first so a stale handle to a reused slot never pairs the old key
+    // with the new map.
+    Slot->Channel.store(Channel, std::memory_order_release);
+    Slot->Map.store(Owned.release(), std::memory_order_release);
+
+    if (IsEmpty(*m_CurrentIndex, Entry))
+      ++m_Claimed;
+    m_CurrentIndex->Keys[Entry] = Channel;
+    m_CurrentIndex->Entries[Entry].store(Slot, std::memory_order_release);
+    return CHandle(Slot, Channel);
+  }
+
+  /**
+   * @brief Removes a channel's map and frees its slot. Existing handles then return nullptr.
+   * @param Channel The channel ID.
+   */
+  void Remove(uint64_t Channel)
+  {
+    std::lock_guard<std::mutex> Lock(m_WriteMutex);
+    size_t Entry = Probe(*m_CurrentIndex, Channel);
+    if (m_CurrentIndex->Keys[Entry] != Channel)
+      return;
+
+    CSlot* Slot = m_CurrentIndex->Entries[Entry].load(std::memory_order_relaxed);
+    Retire(Slot->Map.exchange(nullptr, std::memory_order_acq_rel));
+    Slot->Channel.store(EmptyChannel, std::memory_order_release);
+    m_FreeSlots.push_back(static_cast<size_t>(Slot - m_Slots.get()));
+    m_CurrentIndex->Keys[Entry] = EmptyChannel;
+  }
+
+  /**
+   * @brief Resolves a channel to a handle without locking.
+   * @param Channel The channel ID.
+   * @return The handle, or an empty handle if the channel is not registered.
+   */
+  CHandle Find(uint64_t Channel)
+  {
+    if (Channel == EmptyChannel)
+      return CHandle();
+    const CIndex* Index = m_Index.load(std::memory_order_acquire);
+    for (size_t i = Hash(Channel, Index->Mask);; i = (i + 1) & Index->Mask)
+    {
+      CSlot* Slot = Index->Entries[i].load(std::memory_order_acquire);
+      if (Slot == nullptr)
+        return CHandle();
+      if (Slot->Channel.load(std::memory_order_acquire) == Channel)
+        return CHandle(Slot, Channel);
+    }
+  }
+
+  /**
+   * @brief Gets a channel's current map without locking.
+   *
+   * The map may only be used for lookups; see CCalibrationRegistry.
+   * @param Channel The channel ID.
+   * @return The map, or nullptr if the channel is not registered.
+   */
+  CCalibrationMap* Get(uint64_t Channel)
+  {
+    CHandle Handle = Find(Channel);
+    return Handle ? Handle.Get() : nullptr;
+  }
+
+  /**
+   * @brief Reports the memory used by the whole bank.
+   *
+   * Maps and indexes awaiting reclamation are included. The slots and index are
+   * reported as index bytes.
+   * @return Bytes per representation, summed over every registered map.
+   */
+  CMemoryFootprint MemoryFootprint()
+  {
+    std::lock_guard<std::mutex> Lock(m_WriteMutex);
+    CMemoryFootprint Footprint;
+    Footprint.IndexBytes = m_Capacity * sizeof(CSlot) + (1 + m_RetiredIndexes.size()) * IndexSizeBytes();
+    for (size_t i = 0; i < m_Capacity; ++i)
+    {
+      CCalibrationMap* Map = m_Slots[i].Map.load(std::memory_order_relaxed);
+      if (Map != nullptr)
+        Footprint += Map->MemoryFootprint();
+    }
+    for (size_t i = 0; i < m_Retired.size(); ++i)
+      Footprint += m_Retired[i]->MemoryFootprint();
+    return Footprint;
+  }
+
+  /**
+   * @brief Frees maps that have been replaced or removed, and indexes that have been rebuilt.
+   *
+   * Call only when no reader can still hold a pointer obtained before the
+   * replacement.
+   */
+  void ReclaimRetired()
+  {
+    std::lock_guard<std::mutex> Lock(m_WriteMutex);
+    m_Retired.clear();
+    m_RetiredIndexes.clear();
+  }
+
+private:
+  /**
+   * @brief Channel value marking an unclaimed slot or index entry.
+   */
+  static const uint64_t EmptyChannel = UINT64_MAX;
+
+  /**
+   * @brief The slots, one per channel of capacity.
+   */
+  std::unique_ptr<CSlot[]> m_Slots;
+
+  /**
+   * @brief Indices of slots not holding a channel.
+   */
+  std::vector<size_t> m_FreeSlots;
+
+  /**
+   * @brief Maximum number of channels.
+   */
+  size_t m_Capacity = 0;
+
+  /**
+   * @brief Number of index entries. A power of two.
+   */
+  size_t m_IndexSize = 0;
+
+  /**
+   * @brief Index entries holding a live channel or a tombstone.
+   */
+  size_t m_Claimed = 0;
+
+  /**
+   * @brief The index readers probe.
+   */
+  std::atomic<const CIndex*> m_Index;
+
+  /**
+   * @brief The writer's ownership of the published index.
+   */
+  std::unique_ptr<CIndex> m_CurrentIndex;
+
+  /**
+   * @brief Serialises registration, replacement and reclamation.
+   */
+  std::mutex m_WriteMutex;
+
+  /**
+   * @brief Maps awaiting reclamation.
+   */
+  std::vector<std::unique_ptr<CCalibrationMap>> m_Retired;
+
+  /**
+   * @brief Rebuilt indexes awaiting reclamation.
+   */
+  std::vector<std::unique_ptr<CIndex>> m_RetiredIndexes;
+
+  static size_t Hash(uint64_t Channel, size_t Mask)
+  {
+    Channel = (Channel ^ (Channel >> 33)) * 0xFF51AFD7ED558CCDull;
+    Channel = (Channel ^ (Channel >> 33)) * 0xC4CEB9FE1A85EC53ull;
+    return static_cast<size_t>(Channel ^ (Channel >> 33)) & Mask;
+  }
+
+  size_t IndexSizeBytes()
+  {
+    return sizeof(CIndex) + m_IndexSize * (sizeof(std::atomic<CSlot*>) + sizeof(uint64_t));
+  }
+
+  /**
+   * @brief Finds the channel's entry, or the entry where it would be inserted: the
+   * first tombstone on its probe chain, otherwise the empty entry ending the chain.
+   * @param Index The index to probe.
+   * @param Channel The channel ID.
+   * @return The entry position.
+   */
+  static size_t Probe(const CIndex& Index, uint64_t Channel)
+  {
+    size_t Tombstone = Index.Mask + 1;
+    for (size_t i = Hash(Channel, Index.Mask);; i = (i + 1) & Index.Mask)
+    {
+      if (IsEmpty(Index, i))
+        return Tombstone <= Index.Mask ? Tombstone : i;
+      if (Index.Keys[i] == Channel)
+        return i;
+      if (Index.Keys[i] == EmptyChannel && Tombstone > Index.Mask)
+        Tombstone = i;
+    }
+  }
+
+  static bool IsEmpty(const CIndex& Index, size_t Entry)
+  {
+    return Index.Entries[Entry].load(std::memory_order_relaxed) == nullptr;
+  }
+
+  /**
+   * @brief Publishes an index holding only the live channels and retires the old one.
+   */
+  void Rebuild()
+  {
+    std::unique_ptr<CIndex> Index(new CIndex(m_IndexSize));
+    m_Claimed = 0;
+    for (size_t s = 0; s < m_Capacity; ++s)
+    {
+      uint64_t Channel = m_Slots[s].Channel.load(std::memory_order_relaxed);
+      if (Channel == EmptyChannel)
+        continue;
+      size_t Entry = Probe(*Index, Channel);
+      Index->Keys[Entry] = Channel;
+      Index->Entries[Entry].store(&m_Slots[s], std::memory_order_relaxed);
+      ++m_Claimed;
+    }
+    m_Index.store(Index.get(), std::memory_order_release);
+    m_RetiredIndexes.push_back(std::move(m_CurrentIndex));
+    m_CurrentIndex = std::move(Index);
+  }
+
+  void Retire(CCalibrationMap* Map)
+  {
+    if (Map != nullptr)
+      m_Retired.emplace_back(Map);
+  }
+};
@@ -0,0 +1,142 @@
+/**
+ * @file CCalibrationStreamBuilder.h
+ * @brief Defines the CCalibrationStreamBuilder class for building binary maps from sorted streams.
+ *
+ * Raw scans can be larger than we want to hold in memory before calling
+ * AddPoints(). The builder consumes already-sorted points chunk by chunk and writes
+ * them straight into the CCalibrationFile binary format, using constant memory
+ * apart from the output stream.
+ */
+
+#pragma once
+#include "CCalibrationFile.h"
+
+/**
+ * @class CCalibrationStreamBuilder
+ * @brief Writes the binary map format incrementally from sorted input.
+ *
+ * The point count and checksum are only known at the end, so the output stream
+ * must be seekable; Finish() goes back to fill in the count.
+ */
+class CCalibrationStreamBuilder
+{
+public:
+  /**
+   * @brief Starts a binary map on a stream.
+   * @param Out Seekable stream receiving the map. It must outlive the builder.
+   * @throws std::runtime_error if the stream fails.
+   */
+  explicit CCalibrationStreamBuilder(std::ostream& Out)
+    : m_Out(Out), m_HeaderPosition(Out.tellp())
+  {
+    CCalibrationFile::WriteHeader(m_Out, 0);
+    if (!m_Out || m_HeaderPosition == std::streampos(-1))
+      throw std::runtime_error("Binary calibration output must be a writable, seekable stream.");
+  }
+
+  /**
+   * @brief Appends a chunk of points, as AddPoints() would.
+   * @param Nominals Array of Count nominal values, strictly increasing across all chunks.
+   * @param Calibrated Array of Count corresponding calibrated values.
+   * @param Count Number of points.
+   * @throws std::invalid_argument if the nominal values are not strictly increasing.
+   * @throws std::logic_error if the map has been finished.
+   */
+  void AddChunk(const double* Nominals, const double* Calibrated, size_t Count)
+  {
+    for (size_t i = 0; i < Count; ++i)
+      AddPoint(Nominals[i], Calibrated[i]);
+  }
+
+  /**
+   * @brief Appends a single point, as AddPoint() would.
+   * @param Nominal The nominal value, greater than every previous one.
+   * @param Calibrated The corresponding calibrated value.
+   * @throws std::invalid_argument if the nominal value is not greater than the previous one.
+   * @throws std::logic_error if the map has been finished.
+   */
+  void AddPoint(double Nominal, double Calibrated)
+  {
+    if (m_Finished)
+      throw std::logic_error("Binary calibration map has already been finished.");
+    if (m_Count > 0 && !(Nominal > m_LastNominal))
+      throw std::invalid_argument("Streamed nominal values must be strictly increasing.");
+
+    m_Crc = CCalibrationFile::WritePoint(m_Out, Nominal, Nominal - Calibrated, m_Crc);
+    m_LastNominal = Nominal;
+    ++m_Count;
+  }
+
+  /**
+   * @brief Streams a calibration text file into the binary format.
+   * @param In The text, already sorted by nominal value.
+   * @throws std::invalid_argument if a line is malformed or the values are not strictly increasing.
+   * @throws std::logic_error if the map has been finished.
+   */
+  void AddText(std::istream& In)
+  {
+    std::string Line;
+    size_t LineNumber = 0;
+    while (std::getline(In, Line))
+    {
+      double Nominal;
+      double Calibrated;
+      if (CCalibrationFile::ParsePoint(Line, ++LineNumber, Nominal, Calibrated))
+        AddPoint(Nominal, Calibrated);
+    }
+  }
+
+  /**
+   * @brief Writes the checksum and fills in the point count.
+   * @return The number of points written.
+   * @throws std::runtime_error if the stream fails.
+   */
+  uint64_t Finish()
+  {
+    if (m_Finished)
+      return m_Count;
+
+    CCalibrationFile::WriteValue(m_Out, m_Crc);
+    std::streampos End = m_Out.tellp();
+    m_Out.seekp(m_HeaderPosition + std::streamoff(sizeof(CCalibrationFile::BinaryMagic) + sizeof(uint32_t)));
+    CCalibrationFile::WriteValue(m_Out, m_Count);
+    m_Out.seekp(End);
+    m_Out.flush();
+    if (!m_Out)
+      throw std::runtime_error("Unable to write calibration map.");
+
+    m_Finished = true;
+    return m_Count;
+  }
+
+private:
+  /**
+   * @brief The output stream.
+   */
+  std::ostream& m_Out;
+
+  /**
+   * @brief Position of the binary header in the stream.
+   */
+  std::streampos m_HeaderPosition;
+
+  /**
+   * @brief Running checksum of the written points.
+   */
+  uint32_t m_Crc = 0;
+
+  /**
+   * @brief Number of points written.
+   */
+  uint64_t m_Count = 0;
+
+  /**
+   * @brief The last nominal value written.
+   */
+  double m_LastNominal = 0.0;
+
+  /**
+   * @brief True once Finish() has completed.
+   */
+  bool m_Finished = false;
+};
@@ -0,0 +1,335 @@
+/**
+ * @file CLinearResidualMap.h
+ * @brief Defines the CLinearResidualMap class, a compact linear-plus-residual calibration model.
+ *
+ * Most axis errors are dominated by a linear scale error. This model fits the best
+ * global line to a calibration map once and stores only the residuals from that
+ * line, optionally in a 16-bit encoding, reconstructing the error as the line plus
+ * the linearly interpolated residual.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <cstdint>
+
+/**
+ * @class CHalfFloat
+ * @brief IEEE 754 binary16 storage for normalised residuals.
+ */
+class CHalfFloat
+{
+public:
+  /**
+   * @brief Encodes a value in [-1, 1] with round-to-nearest-even.
+   * @param Value The value to encode.
+   * @return The encoded half-precision value.
+   */
+  static CHalfFloat FromDouble(double Value)
+  {
+    CHalfFloat Half;
+    double Magnitude = std::fabs(Value);
+    uint16_t Sign = std::signbit(Value) ? 0x8000 : 0;
+
+    if (Magnitude < std::ldexp(1.0, -14))
+    {
+      Half.m_Bits = static_cast<uint16_t>(Sign | static_cast<uint16_t>(std::nearbyint(std::ldexp(Magnitude, 24))));
+      return Half;
+    }
+
+    int Exponent;
+    double Fraction = std::frexp(Magnitude, &Exponent);
+    int Biased = Exponent - 1 + 15;
+    int Mantissa = static_cast<int>(std::nearbyint((Fraction * 2.0 - 1.0) * 1024.0));
+    if (Mantissa == 1024)
+    {
+      Mantissa = 0;
+      ++Biased;
+    }
+    Half.m_Bits = static_cast<uint16_t>(Sign | (Biased << 10) | Mantissa);
+    return Half;
+  }
+
+  /**
+   * @brief Decodes the stored value.
+   * @return The value as a double.
+   */
+  double ToDouble() const
+  {
+    int Biased = (m_Bits >> 10) & 0x1F;
+    int Mantissa = m_Bits & 0x3FF;
+    double Magnitude = Biased == 0
+      ? std::ldexp(static_cast<double>(Mantissa), -24)
+      : std::ldexp(1.0 + Mantissa / 1024.0, Biased - 15);
+    return (m_Bits & 0x8000) ? -Magnitude : Magnitude;
+  }
+
+private:
+  /**
+   * @brief Raw binary16 bit pattern.
+   */
+  uint16_t m_Bits = 0;
+};
+
+/**
+ * @brief Encodes residuals for CLinearResidualMap.
+ *
+ * Each specialisation converts residuals to and from its storage type given the
+ * largest residual magnitude, and reports the worst-case representation error.
+ */
+template <typename TResidual>
+struct ResidualCodec;
+
+/**
+ * @brief Stores residuals unchanged. The bound is zero.
+ */
+template <>
+struct ResidualCodec<double>
+{
+  static double Encode(double Residual, double) { return Residual; }
+  static double Decode(double Stored, double) { return Stored; }
+  static double Bound(double) { return 0.0; }
+};
+
+/**
+ * @brief Stores residuals in single precision. The bound is MaxResidual * 2^-24.
+ */
+template <>
+struct ResidualCodec<float>
+{
+  static float Encode(double Residual, double) { return static_cast<float>(Residual); }
+  static double Decode(float Stored, double) { return Stored; }
+  static double Bound(double MaxResidual) { return std::ldexp(MaxResidual, -24); }
+};
+
+/**
+ * @brief Stores residuals normalised to [-1, 1] in half precision.
+ *
+ * Normalised values in [0.5, 1) have a spacing of 2^-11, so rounding error is at
+ * most 2^-12 of the largest residual; smaller values round more finely.
+ */
+template <>
+struct ResidualCodec<CHalfFloat>
+{
+  static CHalfFloat Encode(double Residual, double MaxResidual)
+  {
+    return CHalfFloat::FromDouble(MaxResidual > 0.0 ? Residual / MaxResidual : 0.0);
+  }
+  static double Decode(CHalfFloat Stored, double MaxResidual) { return Stored.ToDouble() * MaxResidual; }
+  static double Bound(double MaxResidual) { return std::ldexp(MaxResidual, -12); }
+};
+
+/**
+ * @brief Stores residuals as fixed point with 32767 steps per largest residual.
+ *
+ * The step is MaxResidual / 32767, so rounding error is at most half a step.
+ */
+template <>
+struct ResidualCodec<int16_t>
+{
+  static int16_t Encode(double Residual, double MaxResidual)
+  {
+    return MaxResidual > 0.0 ? static_cast<int16_t>(std::nearbyint(Residual / MaxResidual * 32767.0)) : 0;
+  }
+  static double Decode(int16_t Stored, double MaxResidual) { return Stored * (MaxResidual / 32767.0); }
+  static double Bound(double MaxResidual) { return MaxResidual / 32767.0 / 2.0; }
+};
+
+/**
+ * @class CLinearResidualMap
+ * @brief Reconstructs calibration errors as a fitted line plus an interpolated residual.
+ *
+ * Nominal breakpoints are kept in double precision; only the residuals use the
+ * compact encoding. Because residuals are interpolated linearly, the deviation from
+ * the source map anywhere in its range is bounded by ResidualBound() plus rounding.
+ * @tparam TResidual Residual storage: double, float, CHalfFloat or int16_t.
+ */
+template <typename TResidual = CHalfFloat>
+class CLinearResidualMap
+{
+public:
+  /**
+   * @brief Fits the least-squares line to a calibration map and stores its residuals.
+   * @param Map The calibration map to model.
+   * @throws std::runtime_error if the map is empty.
+   */
+  void Fit(CCalibrationMap& Map)
+  {
+    const std::map<double, double>& Source = Map.GetMap();
+    if (Source.empty())
+      throw std::runtime_error("Calibration map is empty.");
+
+    double MeanNominal = 0.0;
+    double MeanError = 0.0;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+    {
+      MeanNominal += it->first;
+      MeanError += it->second;
+    }
+    MeanNominal /= Source.size();
+    MeanError /= Source.size();
+
+    double Covariance = 0.0;
+    double Variance = 0.0;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+    {
+      Covariance += (it->first - MeanNominal) * (it->second - MeanError);
+      Variance += (it->first - MeanNominal) * (it->first - MeanNominal);
+    }
+
+    m_Slope = Variance > 0.0 ? Covariance / Variance : 0.0;
+    m_Intercept = MeanError - m_Slope * MeanNominal;
+
+    std::vector<double> Residuals;
+    Residuals.reserve(Source.size());
+    m_Nominals.clear();
+    m_Nominals.reserve(Source.size());
+    m_MaxResidual = 0.0;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+    {
+      m_Nominals.push_back(it->first);
+      Residuals.push_back(it->second - Line(it->first));
+      m_MaxResidual = std::max(m_MaxResidual, std::fabs(Residuals.back()));
+    }
+
+    m_Residuals.clear();
+    m_Residuals.reserve(Residuals.size());
+    for (size_t i = 0; i < Residuals.size(); ++i)
+      m_Residuals.push_back(ResidualCodec<TResidual>::Encode(Residuals[i], m_MaxResidual));
+  }
+
+  /**
+   * @brief Retrieves the reconstructed error value for a given nominal input.
+   * @param Nominal The nominal value.
+   * @return The line value plus the interpolated residual.
+   * @throws std::runtime_error if the model is empty.
+   * @throws std::out_of_range if the nominal value is outside the fitted range.
+   */
+  double ErrorValue(double Nominal)
+  {
+    if (m_Nominals.empty())
+      throw std::runtime_error("Calibration map is empty.");
+
+    auto upper = std::upper_bound(m_Nominals.begin(), m_Nominals.end(), Nominal);
+    size_t Index = upper - m_Nominals.begin();
+
+    if (Index == 0)
+      throw std::out_of_range("Nominal value outside of calibrated range.");
+
+    if (Index == m_Nominals.size())
+    {
+      if (Nominal == m_Nominals.back())
+        return Line(Nominal) + Residual(Index - 1);
+      throw std::out_of_range("Nominal value outside of calibrated range.");
+    }
+
+    double x1 = m_Nominals[Index - 1];
+    double x2 = m_Nominals[Index];
+    double y1 = Residual(Index - 1);
+    return Line(Nominal) + y1 + (Nominal - x1) * (Residual(Index) - y1) / (x2 - x1);
+  }
+
+  /**
+   * @brief Computes the corrected point for a nominal value.
+   * @param Nominal The nominal value to be corrected.
+   * @return The corrected point.
+   * @throws std::runtime_error if the model is empty.
+   * @throws std::out_of_range if the nominal value is outside the fitted range.
+   */
+  double CorrectedPoint(double Nominal)
+  {
+    return Nominal - ErrorValue(Nominal);
+  }
+
+  /**
+   * @brief Gets the slope of the fitted line.
+   * @return Error per unit of nominal.
+   */
+  double GetSlope()
+  {
+    return m_Slope;
+  }
+
+  /**
+   * @brief Gets the intercept of the fitted line.
+   * @return Error at a nominal value of zero.
+   */
+  double GetIntercept()
+  {
+    return m_Intercept;
+  }
+
+  /**
+   * @brief Gets the largest residual magnitude from the fitted line.
+   * @return The largest absolute residual.
+   */
+  double GetMaxResidual()
+  {
+    return m_MaxResidual;
+  }
+
+  /**
+   * @brief Gets the worst-case error introduced by the residual encoding.
+   * @return The bound on |ErrorValue() - source map error| over the fitted range.
+   */
+  double ResidualBound()
+  {
+    return ResidualCodec<TResidual>::Bound(m_MaxResidual);
+  }
+
+  /**
+   * @brief Reports the memory used by the breakpoints and encoded residuals.
+   * @return Bytes per representation.
+   */
+  CMemoryFootprint MemoryFootprint()
+  {
+    CMemoryFootprint Footprint;
+    Footprint.CompressedBytes = m_Nominals.capacity() * sizeof(double) + m_Residuals.capacity() * sizeof(TResidual);
+    return Footprint;
+  }
+
+private:
+  /**
+   * @brief Sorted nominal breakpoints.
+   */
+  std::vector<double> m_Nominals;
+
+  /**
+   * @brief Encoded residuals matching m_Nominals.
+   */
+  std::vector<TResidual> m_Residuals;
+
+  /**
+   * @brief Slope of the fitted line.
+   */
+  double m_Slope = 0.0;
+
+  /**
+   * @brief Intercept of the fitted line.
+   */
+  double m_Intercept = 0.0;
+
+  /**
+   * @brief Largest residual magnitude, used to scale the encoding.
+   */
+  double m_MaxResidual = 0.0;
+
+  /**
+   * @brief Evaluates the fitted line.
+   * @param Nominal The nominal value.
+   * @return The line value.
+   */
+  double Line(double Nominal)
+  {
+    return m_Intercept + m_Slope * Nominal;
+  }
+
+  /**
+   * @brief Decodes a stored residual.
+   * @param Index The breakpoint index.
+   * @return The residual value.
+   */
+  double Residual(size_t Index)
+  {
+    return ResidualCodec<TResidual>::Decode(m_Residuals[Index], m_MaxResidual);
+  }
+};
@@ -0,0 +1,284 @@
+/**
+ * @file CNumaReplicatedMap.h
+ * @brief Defines the CNumaReplicatedMap class, which keeps a frozen table per NUMA node.
+ *
+ * On multi-socket machines, threads on a remote socket pay cross-node latency for
+ * every table access. This class copies a frozen table once per node, from a thread
+ * bound to that node so the kernel's first-touch policy places the copy in
+ * node-local memory, and routes each lookup to the replica of the calling thread's
+ * node. Node topology is read from /sys; on other systems there is one replica.
+ * Nodes are numbered densely in the order of the online list, so sparse node IDs
+ * and memory-only nodes without CPUs do not leave gaps.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+/**
+ * @class CNumaReplicatedMap
+ * @brief Node-local replicas of a frozen calibration table.
+ *
+ * Large tables are allocated with fresh pages, which the copying thread touches
+ * first. Small tables may come from already-touched allocator memory, but those fit
+ * in cache anyway.
+ */
+class CNumaReplicatedMap
+{
+public:
+  /**
+   * @brief Replicates a frozen map's table on every NUMA node.
+   *
+   * A process restricted to some CPUs, for example by a cpuset or taskset, cannot
+   * bind to the other nodes. Their replicas are then copied unbound and may not be
+   * node-local; IsNodeLocal() reports which are.
+   * @param Map The frozen calibration map. Later edits to it are not reflected.
+   * @throws std::invalid_argument if the map is not frozen.
+   * @throws std::bad_alloc if a replica cannot be allocated.
+   */
+  explicit CNumaReplicatedMap(CCalibrationMap& Map)
+  {
+    if (!Map.IsFrozen())
+      throw std::invalid_argument("Calibration map must be frozen before replication.");
+
+    m_SnapTolerance = Map.GetSnapTolerance();
+    DiscoverNodes();
+
+    const CCalibrationMap::FrozenTable& Source = Map.GetFrozenTable();
+    m_Replicas.resize(m_NodeCpus.size());
+    bool Topology = !m_NodeCpus[0].empty();
+    m_Local.assign(m_Replicas.size(), false);
+    for (size_t Node = 0; Node < m_Replicas.size(); ++Node)
+    {
+      std::exception_ptr Error;
+      std::thread Copier([&, Node]()
+      {
+        try
+        {
+          m_Local[Node] = Topology && BindToNode(Node);
+          m_Replicas[Node].reset(new CCalibrationMap::FrozenTable(Source));
+        }
+        catch (...)
+        {
+          Error = std::current_exception();
+        }
+      });
+      Copier.join();
+      if (Error)
+        std::rethrow_exception(Error);
+    }
+  }
+
+  /**
+   * @brief Gets the number of NUMA nodes, and so of replicas.
+   * @return The node count.
+   */
+  size_t NodeCount()
+  {
+    return m_Replicas.size();
+  }
+
+  /**
+   * @brief Indicates whether a replica was copied by a thread bound to its node.
+   * @param Node The node index.
+   * @return False if binding failed or the topology is unknown, so the replica may be remote.
+   * @throws std::out_of_range if the node does not exist.
+   */
+  bool IsNodeLocal(size_t Node)
+  {
+    return m_Local.at(Node);
+  }
+
+  /**
+   * @brief Gets the NUMA node of the CPU the calling thread is running on.
+   * @return The node index, or zero if it cannot be determined.
+   */
+  size_t CurrentNode()
+  {
+#if defined(__linux__)
+    int Cpu = sched_getcpu();
+    if (Cpu >= 0 && static_cast<size_t>(Cpu) < m_CpuNode.size())
+      return m_CpuNode[Cpu];
+#endif
+    return 0;
+  }
+
+  /**
+   * @brief Gets the replica on a given node.
+   * @param Node The node index.
+   * @return The node's copy of the frozen table.
+   * @throws std::out_of_range if the node does not exist.
+   */
+  const CCalibrationMap::FrozenTable& Replica(size_t Node)
+  {
+    return *m_Replicas.at(Node);
+  }
+
+  /**
+   * @brief Retrieves the error value from the calling thread's local replica.
+   * @param Nominal The nominal value.
+   * @return The error value.
+   * @throws std::runtime_error if the table is empty.
+   * @throws std::out_of_range if the nominal value is outside the table range.
+   */
+  double ErrorValue(double Nominal)
+  {
+    size_t Cursor = 0;
+    return m_Replicas[CurrentNode()]->ErrorValue(Nominal, Cursor, m_SnapTolerance);
+  }
+
+  /**
+   * @brief Computes the corrected point using the calling thread's local replica.
+   * @param Nominal The nominal value to be corrected.
+   * @return The corrected point.
+   * @throws std::runtime_error if the table is empty.
+   * @throws std::out_of_range if the nominal value is outside the table range.
+   */
+  double CorrectedPoint(double Nominal)
+  {
+    return Nominal - ErrorValue(Nominal);
+  }
+
+  /**
+   * @brief Computes corrected points for a batch, routed once to the local replica.
+   * @param Nominals View of Count nominal values.
+   * @param Corrected View receiving Count corrected points. It may alias Nominals.
+   * @param Count Number of values.
+   * @throws std::runtime_error if the table is empty.
+   * @throws std::out_of_range if a nominal value is outside the table range. Earlier outputs are already written.
+   */
+  void CorrectedPoints(CStridedArray<const double> Nominals, CStridedArray<double> Corrected, size_t Count)
+  {
+    const CCalibrationMap::FrozenTable& Table = *m_Replicas[CurrentNode()];
+    size_t Cursor = 0;
+    for (size_t i = 0; i < Count; ++i)
+    {
+      double Nominal = Nominals[i];
+      Corrected[i] = Nominal - Table.ErrorValue(Nominal, Cursor, m_SnapTolerance);
+    }
+  }
+
+  /**
+   * @brief Restricts the calling thread to the CPUs of a node.
+   * @param Node The node index.
+   * @return False if the thread could not be bound.
+   */
+  bool BindToNode(size_t Node)
+  {
+#if defined(__linux__)
+    if (Node >= m_NodeCpus.size() || m_NodeCpus[Node].empty())
+      return false;
+    // Sized for the highest CPU number, since CPU_SET is undefined beyond CPU_SETSIZE.
+    int Cpus = static_cast<int>(m_CpuNode.size());
+    cpu_set_t* Set = CPU_ALLOC(Cpus);
+    if (Set == nullptr)
+      return false;
+    size_t Size = CPU_ALLOC_SIZE(Cpus);
+    CPU_ZERO_S(Size, Set);
+    for (size_t i = 0; i < m_NodeCpus[Node].size(); ++i)
+      CPU_SET_S(m_NodeCpus[Node][i], Size, Set);
+    bool Bound = sched_setaffinity(0, Size, Set) == 0;
+    CPU_FREE(Set);
+    return Bound;
+#else
+    (void)Node;
+    return false;
+#endif
+  }
+
+private:
+  /**
+   * @brief One frozen table per node.
+   */
+  std::vector<std::unique_ptr<CCalibrationMap::FrozenTable>> m_Replicas;
+
+  /**
+   * @brief Whether each replica was copied from a thread bound to its node.
+   */
+  std::vector<bool> m_Local;
+
+  /**
+   * @brief CPUs belonging to each node.
+   */
+  std::vector<std::vector<int>> m_NodeCpus;
+
+  /**
+   * @brief Node of each CPU.
+   */
+  std::vector<size_t> m_CpuNode;
+
+  /**
+   * @brief Snap tolerance copied from the source map.
+   */
+  double m_SnapTolerance = 0.0;
+
+  /**
+   * @brief Reads the node to CPU mapping from /sys/devices/system/node.
+   *
+   * Node IDs come from the online list, which may be sparse. Nodes without CPUs
+   * hold memory only and get no replica, since no thread runs there.
+   */
+  void DiscoverNodes()
+  {
+#if defined(__linux__)
+    std::vector<int> Online = ReadList("/sys/devices/system/node/online");
+    for (size_t i = 0; i < Online.size(); ++i)
+    {
+      std::vector<int> Cpus = ReadList("/sys/devices/system/node/node" + std::to_string(Online[i]) + "/cpulist");
+      if (Cpus.empty())
+        continue;
+      for (size_t c = 0; c < Cpus.size(); ++c)
+      {
+        if (m_CpuNode.size() <= static_cast<size_t>(Cpus[c]))
+          m_CpuNode.resize(Cpus[c] + 1, 0);
+        m_CpuNode[Cpus[c]] = m_NodeCpus.size();
+      }
+      m_NodeCpus.push_back(Cpus);
+    }
+#endif
+    if (m_NodeCpus.empty())
+      m_NodeCpus.push_back(std::vector<int>());
+  }
+
+  /**
+   * @brief Reads a kernel range list such as "0-3,8,10-11".
+   * @param Path The file to read.
+   * @return The listed numbers, or an empty list if the file is missing or malformed.
+   */
+  static std::vector<int> ReadList(const std::string& Path)
+  {
+    std::vector<int> Values;
+    std::ifstream File(Path);
+    std::string Text;
+    if (!File || !std::getline(File, Text))
+      return Values;
+
+    std::istringstream Ranges(Text);
+    std::string Range;
+    while (std::getline(Ranges, Range, ','))
+    {
+      if (Range.empty())
+        continue;
+      size_t Dash = Range.find('-');
+      try
+      {
+        int First = std::stoi(Range.substr(0, Dash));
+        int Last = Dash == std::string::npos ? First : std::stoi(Range.substr(Dash + 1));
+        for (int Value = First; Value <= Last; ++Value)
+          Values.push_back(Value);
+      }
+      catch (const std::exception&)
+      {
+        return std::vector<int>();
+      }
+    }
+    return Values;
+  }
+};
@@ -0,0 +1,320 @@
+/**
+ * @file CPeriodicErrorModel.h
+ * @brief Defines the CPeriodicErrorModel class for cyclic calibration errors.
+ *
+ * Lead-screw and encoder errors repeat with a fixed period. This model fits a
+ * truncated Fourier series to the periodic part of a calibration map and keeps
+ * the non-periodic remainder in an ordinary CCalibrationMap, which can be frozen
+ * with collinear merging so that only its slow trend costs memory.
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <complex>
+
+/**
+ * @class CPeriodicErrorModel
+ * @brief Reconstructs calibration errors as a remainder table plus a Fourier series.
+ *
+ * The series is evaluated with the angle-addition recurrence, so each harmonic
+ * costs a few multiplies instead of a sin/cos call.
+ */
+class CPeriodicErrorModel
+{
+public:
+  /**
+   * @brief Fits the periodic part of a calibration map.
+   *
+   * The map is resampled uniformly over the largest whole number of periods it
+   * covers, detrended between the window end points and transformed with a radix-2
+   * FFT. The first Harmonics bins that are multiples of the period are kept; the
+   * rest of the error is stored per breakpoint in the remainder table.
+   * @param Map The calibration map to model.
+   * @param Period The period of the cyclic error, in nominal units.
+   * @param Harmonics The number of harmonics to keep.
+   * @param SamplesPerPeriod Uniform samples per period used for the FFT.
+   * @param Options Freeze options applied to the remainder table.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::invalid_argument if the map does not span one period or the sampling is below the Nyquist rate.
+   */
+  void Fit(CCalibrationMap& Map, double Period, size_t Harmonics, size_t SamplesPerPeriod,
+    const CCalibrationMap::FreezeOptions& Options)
+  {
+    const std::map<double, double>& Source = Map.GetMap();
+    if (Source.empty())
+      throw std::runtime_error("Calibration map is empty.");
+    if (!(Period > 0.0))
+      throw std::invalid_argument("Period must be positive.");
+    if (SamplesPerPeriod <= 2 * Harmonics)
+      throw std::invalid_argument("SamplesPerPeriod must exceed twice the number of harmonics.");
+
+    double First = Source.begin()->first;
+    double Last = std::prev(Source.end())->first;
+    double Span = Last - First;
+    size_t Periods = static_cast<size_t>(std::floor(Span / Period));
+    if (Periods == 0)
+      throw std::invalid_argument("Calibration map must span at least one period.");
+
+    size_t Count = 1;
+    while (Count < Periods * SamplesPerPeriod)
+      Count <<= 1;
+
+    double Window = Periods * Period;
+    double Step = Window / Count;
+    double StartError = Map.ErrorValue(First);
+    // First + Window can round past the last breakpoint, so samples are clamped to it.
+    double EndError = Map.ErrorValue(std::min(First + Window, Last));
+
+    std::vector<std::complex<double>> Samples(Count);
+    for (size_t i = 0; i < Count; ++i)
+    {
+      double Offset = i * Step;
+      double Trend = StartError + (EndError - StartError) * Offset / Window;
+      Samples[i] = Map.ErrorValue(std::min(First + Offset, Last)) - Trend;
+    }
+    Transform(Samples);
+
+    m_Origin = First;
+    m_Period = Period;
+    m_Cosine.assign(Harmonics, 0.0);
+    m_Sine.assign(Harmonics, 0.0);
+    for (size_t h = 0; h < Harmonics; ++h)
+    {
+      std::complex<double> Bin = Samples[(h + 1) * Periods];
+      m_Cosine[h] = 2.0 * Bin.real() / Count;
+      m_Sine[h] = -2.0 * Bin.imag() / Count;
+    }
+
+    std::map<double, double> Remainder;
+    for (auto it = Source.begin(); it != Source.end(); ++it)
+      Remainder.emplace_hint(Remainder.end(), it->first, it->second - Periodic(it->first));
+    m_Remainder.SetMap(std::move(Remainder));
+    m_Remainder.Freeze(Options);
+
+    // Keep only the breakpoints that survived merging, so the tree does not
+    // cost as much as the original map. Refreezing them reproduces the table.
+    const CCalibrationMap::FrozenTable& Table = m_Remainder.GetFrozenTable();
+    std::map<double, double> Kept;
+    for (size_t i = 0; i < Table.Nominals.size(); ++i)
+    {
+      double Error = Table.Storage == CCalibrationMap::StorageType::Float ? Table.FloatErrors[i] : Table.Errors[i];
+      Kept.emplace_hint(Kept.end(), Table.Nominals[i], Error);
+    }
+    CCalibrationMap::FreezeOptions Refreeze = Options;
+    Refreeze.Merge = CCalibrationMap::MergeMode::None;
+    m_Remainder.SetMap(std::move(Kept));
+    m_Remainder.Freeze(Refreeze);
+  }
+
+  /**
+   * @brief Fits the periodic part of a calibration map, freezing the remainder without merging.
+   * @param Map The calibration map to model.
+   * @param Period The period of the cyclic error, in nominal units.
+   * @param Harmonics The number of harmonics to keep.
+   * @param SamplesPerPeriod Uniform samples per period used for the FFT.
+   * @throws std::runtime_error if the map is empty.
+   * @throws std::invalid_argument if the map does not span one period or the sampling is below the Nyquist rate.
+   */
+  void Fit(CCalibrationMap& Map, double Period, size_t Harmonics, size_t SamplesPerPeriod = 64)
+  {
+    Fit(Map, Period, Harmonics, SamplesPerPeriod, CCalibrationMap::FreezeOptions());
+  }
+
+  /**
+   * @brief Retrieves the reconstructed error value for a given nominal input.
+   * @param Nominal The nominal value.
+   * @return The remainder table value plus the Fourier series.
+   * @throws std::runtime_error if the model has not been fitted.
+   * @throws std::out_of_range if the nominal value is outside the fitted range.
+   */
+  double ErrorValue(double Nominal)
+  {
+    return m_Remainder.ErrorValue(Nominal) + Periodic(Nominal);
+  }
+
+  /**
+   * @brief Computes the corrected point for a nominal value.
+   * @param Nominal The nominal value to be corrected.
+   * @return The corrected point.
+   * @throws std::runtime_error if the model has not been fitted.
+   * @throws std::out_of_range if the nominal value is outside the fitted range.
+   */
+  double CorrectedPoint(double Nominal)
+  {
+    return Nominal - ErrorValue(Nominal);
+  }
+
+  /**
+   * @brief Retrieves error values for a block of nominal inputs.
+   *
+   * Samples are processed in groups of Lanes so the harmonic recurrence runs
+   * across independent samples and can be vectorised by the compiler.
+   * @param Nominals Array of Count nominal values.
+   * @param Errors Array receiving Count error values.
+   * @param Count Number of values.
+   * @throws std::runtime_error if the model has not been fitted.
+   * @throws std::out_of_range if any nominal value is outside the fitted range.
+   */
+  void ErrorValues(const double* Nominals, double* Errors, size_t Count)
+  {
+    const size_t Lanes = 8;
+    double Omega = 2.0 * Pi / m_Period;
+    double Cos1[Lanes], Sin1[Lanes], Cos[Lanes], Sin[Lanes], Sum[Lanes];
+
+    for (size_t Base = 0; Base < Count; Base += Lanes)
+    {
+      size_t Width = std::min(Lanes, Count - Base);
+      for (size_t l = 0; l < Lanes; ++l)
+      {
+        double Angle = l < Width ? Omega * (Nominals[Base + l] - m_Origin) : 0.0;
+        Cos1[l] = Cos[l] = std::cos(Angle);
+        Sin1[l] = Sin[l] = std::sin(Angle);
+        Sum[l] = 0.0;
+      }
+
+      for (size_t h = 0; h < m_Cosine.size(); ++h)
+      {
+        double a = m_Cosine[h];
+        double b = m_Sine[h];
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+          Sum[l] += a * Cos[l] + b * Sin[l];
+          double NextCos = Cos[l] * Cos1[l] - Sin[l] * Sin1[l];
+          Sin[l] = Sin[l] * Cos1[l] + Cos[l] * Sin1[l];
+          Cos[l] = NextCos;
+        }
+      }
+
+      for (size_t l = 0; l < Width; ++l)
+        Errors[Base + l] = m_Remainder.ErrorValue(Nominals[Base + l]) + Sum[l];
+    }
+  }
+
+  /**
+   * @brief Gets the table holding the non-periodic part of the error.
+   * @return The remainder calibration map.
+   */
+  CCalibrationMap& GetRemainder()
+  {
+    return m_Remainder;
+  }
+
+  /**
+   * @brief Gets the cosine coefficients, starting with the fundamental.
+   * @return One coefficient per harmonic.
+   */
+  const std::vector<double>& GetCosineCoefficients()
+  {
+    return m_Cosine;
+  }
+
+  /**
+   * @brief Gets the sine coefficients, starting with the fundamental.
+   * @return One coefficient per harmonic.
+   */
+  const std::vector<double>& GetSineCoefficients()
+  {
+    return m_Sine;
+  }
+
+  /**
+   * @brief Reports the memory used by the coefficients and the remainder table.
+   * @return Bytes per representation.
+   */
+  CMemoryFootprint MemoryFootprint()
+  {
+    CMemoryFootprint Footprint = m_Remainder.MemoryFootprint();
+    Footprint.CoefficientBytes += (m_Cosine.capacity() + m_Sine.capacity()) * sizeof(double);
+    return Footprint;
+  }
+
+private:
+  /**
+   * @brief The constant pi.
+   */
+  static constexpr double Pi = 3.14159265358979323846;
+
+  /**
+   * @brief Non-periodic part of the error.
+   */
+  CCalibrationMap m_Remainder;
+
+  /**
+   * @brief Cosine coefficient of each harmonic.
+   */
+  std::vector<double> m_Cosine;
+
+  /**
+   * @brief Sine coefficient of each harmonic.
+   */
+  std::vector<double> m_Sine;
+
+  /**
+   * @brief Nominal value at phase zero.
+   */
+  double m_Origin = 0.0;
+
+  /**
+   * @brief Period of the cyclic error.
+   */
+  double m_Period = 1.0;
+
+  /**
+   * @brief Evaluates the Fourier series at a single nominal value.
+   * @param Nominal The nominal value.
+   * @return The periodic part of the error.
+   */
+  double Periodic(double Nominal)
+  {
+    double Angle = 2.0 * Pi * (Nominal - m_Origin) / m_Period;
+    double Cos1 = std::cos(Angle);
+    double Sin1 = std::sin(Angle);
+    double Cos = Cos1;
+    double Sin = Sin1;
+    double Sum = 0.0;
+    for (size_t h = 0; h < m_Cosine.size(); ++h)
+    {
+      Sum += m_Cosine[h] * Cos + m_Sine[h] * Sin;
+      double NextCos = Cos * Cos1 - Sin * Sin1;
+      Sin = Sin * Cos1 + Cos * Sin1;
+      Cos = NextCos;
+    }
+    return Sum;
+  }
+
+  /**
+   * @brief Computes an in-place forward radix-2 FFT.
+   * @param Data Samples to transform; the size must be a power of two.
+   */
+  static void Transform(std::vector<std::complex<double>>& Data)
+  {
+    size_t Count = Data.size();
+    for (size_t i = 1, j = 0; i < Count; ++i)
+    {
+      size_t Bit = Count >> 1;
+      for (; j & Bit; Bit >>= 1)
+        j ^= Bit;
+      j ^= Bit;
+      if (i < j)
+        std::swap(Data[i], Data[j]);
+    }
+
+    for (size_t Length = 2; Length <= Count; Length <<= 1)
+    {
+      double Angle = -2.0 * Pi / Length;
+      std::complex<double> Root(std::cos(Angle), std::sin(Angle));
+      for (size_t Start = 0; Start < Count; Start += Length)
+      {
+        std::complex<double> Twiddle(1.0, 0.0);
+        for (size_t k = 0; k < Length / 2; ++k)
+        {
+          std::complex<double> Even = Data[Start + k];
+          std::complex<double> Odd = Data[Start + k + Length / 2] * Twiddle;
+          Data[Start + k] = Even + Odd;
+          Data[Start + k + Length / 2] = Even - Odd;
+          Twiddle *= Root;
+        }
+      }
+    }
+  }
+};
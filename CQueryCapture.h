@@ -0,0 +1,212 @@
+/**
+ * @file CQueryCapture.h
+ * @brief Defines CQueryCapture, which records lookup queries, and CQueryTrace, which reads them back.
+ *
+ * A capture file is the magic "CQRY" and a 32-bit version, followed by one record
+ * per query until the end of the file. A record is the time since the previous
+ * query in nanoseconds as an LEB128 varint, then the nominal value XORed with the
+ * previous nominal: one byte giving how many low-order bytes of the XOR are
+ * non-zero, followed by those bytes, least significant first. The time takes one
+ * byte below 128 ns, two below 16 us, three below 2 ms and four below 268 ms, so
+ * a repeated setpoint queried at 1 kHz costs four bytes; a nearby value adds the
+ * few XOR bytes that changed.
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @class CQueryCapture
+ * @brief Appends queries with timestamps to a capture file.
+ *
+ * Record() is thread-safe, so a capture can be attached to a map shared by
+ * several threads; their queries are interleaved in arrival order. It reads the
+ * clock and takes a mutex on every lookup, which is the capture's overhead on the
+ * hot path and serialises threads sharing a capture; detach it when not tracing.
+ */
+class CQueryCapture
+{
+public:
+  /**
+   * @brief Creates a capture file, replacing any existing file.
+   * @param Path The file path.
+   * @throws std::runtime_error if the file cannot be created.
+   */
+  explicit CQueryCapture(const std::string& Path)
+    : m_Out(Path, std::ios::binary | std::ios::trunc), m_Last(std::chrono::steady_clock::now())
+  {
+    m_Out.write(Magic, sizeof(Magic));
+    m_Out.write(reinterpret_cast<const char*>(&Version), sizeof(Version));
+    if (!m_Out)
+      throw std::runtime_error("Unable to create query capture " + Path + ".");
+  }
+
+  /**
+   * @brief Records a query. Takes the capture's mutex.
+   * @param Nominal The nominal value queried.
+   */
+  void Record(double Nominal)
+  {
+    auto Now = std::chrono::steady_clock::now();
+    uint64_t Bits;
+    std::memcpy(&Bits, &Nominal, sizeof(Bits));
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    uint64_t Delta = 0;
+    if (Now > m_Last)
+    {
+      Delta = std::chrono::duration_cast<std::chrono::nanoseconds>(Now - m_Last).count();
+      m_Last = Now;
+    }
+
+    char Record[19];
+    size_t Size = 0;
+    do
+    {
+      Record[Size++] = static_cast<char>((Delta & 0x7F) | (Delta >= 0x80 ? 0x80 : 0));
+      Delta >>= 7;
+    } while (Delta);
+
+    uint64_t Xor = Bits ^ m_Previous;
+    m_Previous = Bits;
+    size_t Bytes = 0;
+    while (Bytes < 8 && (Xor >> (8 * Bytes)) != 0)
+      ++Bytes;
+    Record[Size++] = static_cast<char>(Bytes);
+    for (size_t i = 0; i < Bytes; ++i)
+      Record[Size++] = static_cast<char>(Xor >> (8 * i));
+
+    m_Out.write(Record, Size);
+    ++m_Count;
+  }
+
+  /**
+   * @brief Gets the number of queries recorded.
+   * @return The query count.
+   */
+  uint64_t GetCount()
+  {
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    return m_Count;
+  }
+
+  /**
+   * @brief Flushes buffered records to the file.
+   * @throws std::runtime_error if writing failed.
+   */
+  void Flush()
+  {
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    m_Out.flush();
+    if (!m_Out)
+      throw std::runtime_error("Unable to write query capture.");
+  }
+
+  /**
+   * @brief Magic bytes opening a capture file.
+   */
+  static constexpr char Magic[4] = { 'C', 'Q', 'R', 'Y' };
+
+  /**
+   * @brief Version of the capture format.
+   */
+  static constexpr uint32_t Version = 1;
+
+private:
+  /**
+   * @brief The capture file.
+   */
+  std::ofstream m_Out;
+
+  /**
+   * @brief Serializes writers.
+   */
+  std::mutex m_Lock;
+
+  /**
+   * @brief Time of the previous query, or of creation before the first.
+   */
+  std::chrono::steady_clock::time_point m_Last;
+
+  /**
+   * @brief Bit pattern of the previous nominal value.
+   */
+  uint64_t m_Previous = 0;
+
+  /**
+   * @brief Queries recorded.
+   */
+  uint64_t m_Count = 0;
+};
+
+/**
+ * @struct CQueryTrace
+ * @brief A captured query sequence, loaded for replay.
+ */
+struct CQueryTrace
+{
+  std::vector<double> Nominals;  ///< Nominal values in capture order.
+  std::vector<uint64_t> Times;   ///< Nanoseconds from the start of the capture to each query.
+
+  /**
+   * @brief Loads a capture file.
+   * @param Path The file path.
+   * @return The trace.
+   * @throws std::runtime_error if the file cannot be read, is not a capture or ends mid-record.
+   */
+  static CQueryTrace Load(const std::string& Path)
+  {
+    std::ifstream In(Path, std::ios::binary);
+    std::string Data((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    if (!In.eof() && !In)
+      throw std::runtime_error("Unable to read query capture " + Path + ".");
+
+    uint32_t FileVersion = 0;
+    if (Data.size() < 8 || std::memcmp(Data.data(), CQueryCapture::Magic, 4) != 0)
+      throw std::runtime_error("Not a query capture: " + Path + ".");
+    std::memcpy(&FileVersion, Data.data() + 4, sizeof(FileVersion));
+    if (FileVersion != CQueryCapture::Version)
+      throw std::runtime_error("Unsupported query capture version in " + Path + ".");
+
+    CQueryTrace Trace;
+    const unsigned char* Cursor = reinterpret_cast<const unsigned char*>(Data.data()) + 8;
+    const unsigned char* End = reinterpret_cast<const unsigned char*>(Data.data()) + Data.size();
+    uint64_t Time = 0;
+    uint64_t Bits = 0;
+    while (Cursor < End)
+    {
+      uint64_t Delta = 0;
+      for (unsigned Shift = 0;; Shift += 7)
+      {
+        if (Cursor == End || Shift > 63)
+          throw std::runtime_error("Query capture is truncated.");
+        Delta |= uint64_t(*Cursor & 0x7F) << Shift;
+        if ((*Cursor++ & 0x80) == 0)
+          break;
+      }
+
+      if (Cursor == End || *Cursor > 8 || size_t(End - Cursor) < size_t(*Cursor) + 1)
+        throw std::runtime_error("Query capture is truncated.");
+      size_t Bytes = *Cursor++;
+      uint64_t Xor = 0;
+      for (size_t i = 0; i < Bytes; ++i)
+        Xor |= uint64_t(*Cursor++) << (8 * i);
+      Bits ^= Xor;
+      Time += Delta;
+
+      double Nominal;
+      std::memcpy(&Nominal, &Bits, sizeof(Nominal));
+      Trace.Nominals.push_back(Nominal);
+      Trace.Times.push_back(Time);
+    }
+    return Trace;
+  }
+};
@@ -0,0 +1,372 @@
+/**
+ * @file CVersionedCalibrationMap.h
+ * @brief Defines the CVersionedCalibrationMap class for querying historical map versions.
+ *
+ * Quality investigations need corrections "as they were" at a past time. This map
+ * keeps every committed version in a persistent treap: an edit copies only the
+ * O(log n) nodes on its search path and shares the rest with earlier versions, so
+ * each retained version is cheap and any of them can be queried in O(log n).
+ */
+
+#pragma once
+#include "CCalibrationMap.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/**
+ * @class CVersionedCalibrationMap
+ * @brief Calibration map whose committed versions remain queryable.
+ *
+ * Edits are made to a working version; Commit() stamps it with a time and retains
+ * it. Versions are numbered from zero in commit order.
+ */
+class CVersionedCalibrationMap
+{
+public:
+  typedef std::chrono::system_clock::time_point TimePoint;
+
+  /**
+   * @brief Adds a single calibration point to the working version.
+   * @param Nominal The nominal value.
+   * @param Calibrated The corresponding calibrated value.
+   */
+  void AddPoint(double Nominal, double Calibrated)
+  {
+    NodePtr Less, Rest, Equal, Greater;
+    Split(m_Working, Nominal, false, Less, Rest);
+    Split(Rest, Nominal, true, Equal, Greater);
+    m_Working = Merge(Merge(Less, MakeNode(Nominal, Nominal - Calibrated, nullptr, nullptr)), Greater);
+  }
+
+  /**
+   * @brief Removes a single calibration point from the working version.
+   * @param Nominal The nominal value of the point to remove. Missing points are ignored.
+   */
+  void RemovePoint(double Nominal)
+  {
+    NodePtr Less, Rest, Equal, Greater;
+    Split(m_Working, Nominal, false, Less, Rest);
+    Split(Rest, Nominal, true, Equal, Greater);
+    m_Working = Merge(Less, Greater);
+  }
+
+  /**
+   * @brief Replaces the working version.
+   * @param Map A map of nominal values and their error values.
+   */
+  void SetMap(const std::map<double, double>& Map)
+  {
+    std::vector<std::shared_ptr<CNode>> Spine;
+    for (auto it = Map.begin(); it != Map.end(); ++it)
+    {
+      std::shared_ptr<CNode> Node = std::make_shared<CNode>(it->first, it->second, Priority(it->first));
+      std::shared_ptr<CNode> Last;
+      while (!Spine.empty() && Spine.back()->Priority < Node->Priority)
+      {
+        Last = Spine.back();
+        Spine.pop_back();
+      }
+      Node->Left = Last;
+      if (!Spine.empty())
+        Spine.back()->Right = Node;
+      Spine.push_back(Node);
+    }
+    m_Working = Spine.empty() ? NodePtr() : NodePtr(Spine.front());
+  }
+
+  /**
+   * @brief Retains the working version.
+   * @param Time The time the version takes effect.
+   * @return The number of the committed version.
+   * @throws std::invalid_argument if Time is earlier than the previous commit.
+   */
+  size_t Commit(TimePoint Time = std::chrono::system_clock::now())
+  {
+    if (!m_Versions.empty() && Time < m_Versions.back().Time)
+      throw std::invalid_argument("Versions must be committed in time order.");
+    m_Versions.push_back(CVersion { Time, m_Working });
+    return m_Versions.size() - 1;
+  }
+
+  /**
+   * @brief Gets the number of committed versions.
+   * @return The version count.
+   */
+  size_t VersionCount()
+  {
+    return m_Versions.size();
+  }
+
+  /**
+   * @brief Finds the version in effect at a given time.
+   * @param Time The time of interest.
+   * @return The latest version committed at or before Time.
+   * @throws std::out_of_range if no version was committed by Time.
+   */
+  size_t VersionAt(TimePoint Time)
+  {
+    auto upper = std::upper_bound(m_Versions.begin(), m_Versions.end(), Time,
+      [](TimePoint Value, const CVersion& Version) { return Value < Version.Time; });
+    if (upper == m_Versions.begin())
+      throw std::out_of_range("No calibration version was committed by the requested time.");
+    return (upper - m_Versions.begin()) - 1;
+  }
+
+  /**
+   * @brief Gets the time a version was committed.
+   * @param Version The version number.
+   * @return The commit time.
+   * @throws std::out_of_range if the version does not exist.
+   */
+  TimePoint CommitTime(size_t Version)
+  {
+    return m_Versions.at(Version).Time;
+  }
+
+  /**
+   * @brief Retrieves the error value from the working version.
+   * @param Nominal The nominal value.
+   * @return The error value.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if the nominal value is outside the version's range.
+   */
+  double ErrorValue(double Nominal)
+  {
+    return Lookup(m_Working.get(), Nominal);
+  }
+
+  /**
+   * @brief Retrieves the error value from a committed version.
+   * @param Nominal The nominal value.
+   * @param Version The version number.
+   * @return The error value.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if the version does not exist or the nominal value is outside its range.
+   */
+  double ErrorValue(double Nominal, size_t Version)
+  {
+    return Lookup(m_Versions.at(Version).Root.get(), Nominal);
+  }
+
+  /**
+   * @brief Retrieves the error value as it was at a given time.
+   * @param Nominal The nominal value.
+   * @param Time The time of interest.
+   * @return The error value from the version in effect at Time.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if no version was committed by Time or the nominal value is outside its range.
+   */
+  double ErrorValue(double Nominal, TimePoint Time)
+  {
+    return ErrorValue(Nominal, VersionAt(Time));
+  }
+
+  /**
+   * @brief Computes the corrected point using a committed version.
+   * @param Nominal The nominal value to be corrected.
+   * @param Version The version number.
+   * @return The corrected point.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if the version does not exist or the nominal value is outside its range.
+   */
+  double CorrectedPoint(double Nominal, size_t Version)
+  {
+    return Nominal - ErrorValue(Nominal, Version);
+  }
+
+  /**
+   * @brief Computes the corrected point as it was at a given time.
+   * @param Nominal The nominal value to be corrected.
+   * @param Time The time of interest.
+   * @return The corrected point.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if no version was committed by Time or the nominal value is outside its range.
+   */
+  double CorrectedPoint(double Nominal, TimePoint Time)
+  {
+    return Nominal - ErrorValue(Nominal, Time);
+  }
+
+  /**
+   * @brief Copies a committed version into an ordinary calibration map.
+   * @param Version The version number.
+   * @return The calibration map.
+   * @throws std::out_of_range if the version does not exist.
+   */
+  CCalibrationMap Checkout(size_t Version)
+  {
+    std::map<double, double> Points;
+    Collect(m_Versions.at(Version).Root.get(), Points);
+    CCalibrationMap Map;
+    Map.SetMap(std::move(Points));
+    return Map;
+  }
+
+private:
+  struct CNode;
+  typedef std::shared_ptr<const CNode> NodePtr;
+
+  /**
+   * @brief Immutable treap node, shared between versions.
+   */
+  struct CNode
+  {
+    CNode(double NominalValue, double ErrorValue, uint64_t NodePriority)
+      : Nominal(NominalValue), Error(ErrorValue), Priority(NodePriority)
+    {
+    }
+
+    double Nominal;
+    double Error;
+    uint64_t Priority;
+    NodePtr Left;
+    NodePtr Right;
+  };
+
+  /**
+   * @brief A committed version.
+   */
+  struct CVersion
+  {
+    TimePoint Time;
+    NodePtr Root;
+  };
+
+  /**
+   * @brief Root of the working version.
+   */
+  NodePtr m_Working;
+
+  /**
+   * @brief Committed versions in commit order.
+   */
+  std::vector<CVersion> m_Versions;
+
+  /**
+   * @brief Derives a node priority from its key, so equal contents give equal shapes.
+   * @param Nominal The nominal value.
+   * @return The priority.
+   */
+  static uint64_t Priority(double Nominal)
+  {
+    uint64_t Bits;
+    std::memcpy(&Bits, &Nominal, sizeof(Bits));
+    Bits += 0x9E3779B97F4A7C15ull;
+    Bits = (Bits ^ (Bits >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Bits = (Bits ^ (Bits >> 27)) * 0x94D049BB133111EBull;
+    return Bits ^ (Bits >> 31);
+  }
+
+  static NodePtr MakeNode(double Nominal, double Error, NodePtr Left, NodePtr Right)
+  {
+    std::shared_ptr<CNode> Node = std::make_shared<CNode>(Nominal, Error, Priority(Nominal));
+    Node->Left = std::move(Left);
+    Node->Right = std::move(Right);
+    return Node;
+  }
+
+  static NodePtr CopyNode(const CNode& Source, NodePtr Left, NodePtr Right)
+  {
+    std::shared_ptr<CNode> Node = std::make_shared<CNode>(Source.Nominal, Source.Error, Source.Priority);
+    Node->Left = std::move(Left);
+    Node->Right = std::move(Right);
+    return Node;
+  }
+
+  /**
+   * @brief Splits a tree by key, copying only the nodes on the split path.
+   * @param Root The tree to split.
+   * @param Nominal The split key.
+   * @param Inclusive If true, keys equal to Nominal go to Left.
+   * @param Left Receives the keys below (or not above) Nominal.
+   * @param Right Receives the remaining keys.
+   */
+  static void Split(const NodePtr& Root, double Nominal, bool Inclusive, NodePtr& Left, NodePtr& Right)
+  {
+    if (!Root)
+    {
+      Left.reset();
+      Right.reset();
+      return;
+    }
+
+    if (Root->Nominal < Nominal || (Inclusive && Root->Nominal == Nominal))
+    {
+      NodePtr Lower;
+      Split(Root->Right, Nominal, Inclusive, Lower, Right);
+      Left = CopyNode(*Root, Root->Left, Lower);
+    }
+    else
+    {
+      NodePtr Upper;
+      Split(Root->Left, Nominal, Inclusive, Left, Upper);
+      Right = CopyNode(*Root, Upper, Root->Right);
+    }
+  }
+
+  /**
+   * @brief Joins two trees whose keys are ordered, copying only the nodes on the seam.
+   * @param Left Tree with the lower keys.
+   * @param Right Tree with the higher keys.
+   * @return The joined tree.
+   */
+  static NodePtr Merge(const NodePtr& Left, const NodePtr& Right)
+  {
+    if (!Left)
+      return Right;
+    if (!Right)
+      return Left;
+
+    if (Left->Priority > Right->Priority)
+      return CopyNode(*Left, Left->Left, Merge(Left->Right, Right));
+    return CopyNode(*Right, Merge(Left, Right->Left), Right->Right);
+  }
+
+  /**
+   * @brief Finds the error value in one version by a single descent.
+   * @param Root The version's root.
+   * @param Nominal The nominal value.
+   * @return The error value.
+   * @throws std::runtime_error if the version is empty.
+   * @throws std::out_of_range if the nominal value is outside the version's range.
+   */
+  static double Lookup(const CNode* Root, double Nominal)
+  {
+    if (Root == nullptr)
+      throw std::runtime_error("Calibration map is empty.");
+
+    const CNode* Lower = nullptr;
+    const CNode* Upper = nullptr;
+    for (const CNode* Node = Root; Node != nullptr;)
+    {
+      if (Nominal == Node->Nominal)
+        return Node->Error;
+      if (Nominal < Node->Nominal)
+      {
+        Upper = Node;
+        Node = Node->Left.get();
+      }
+      else
+      {
+        Lower = Node;
+        Node = Node->Right.get();
+      }
+    }
+
+    if (Lower == nullptr || Upper == nullptr)
+      throw std::out_of_range("Nominal value outside of calibrated range.");
+
+    return Lower->Error + (Nominal - Lower->Nominal) * (Upper->Error - Lower->Error) / (Upper->Nominal - Lower->Nominal);
+  }
+
+  static void Collect(const CNode* Node, std::map<double, double>& Points)
+  {
+    if (Node == nullptr)
+      return;
+    Collect(Node->Left.get(), Points);
+    Points.emplace_hint(Points.end(), Node->Nominal, Node->Error);
+    Collect(Node->Right.get(), Points);
+  }
+};
@@ -0,0 +1,201 @@
+/**
+ * @file BenchCompare.cpp
+ * @brief Compares benchmark results against a stored baseline and fails on significant regressions.
+ *
+ * Build: g++ -O2 -std=c++17 BenchCompare.cpp -o BenchCompare
+ * Usage: BenchCompare baseline.json current.json [threshold] [confidence]
+ *
+ * For every benchmark in the baseline, the change in mean is tested with Welch's
+ * t-test, which does not assume equal variances, and a confidence interval for
+ * the relative change is printed. A benchmark regresses when it is slower by more
+ * than the threshold (default 0.05, i.e. 5%) and the difference is significant at
+ * the confidence level (default 0.99). The exit code is 2 on bad input or if a
+ * baseline benchmark is missing from the current run, 1 if any benchmark
+ * regressed and 0 otherwise.
+ */
+
+#include "BenchResults.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+/**
+ * @brief Evaluates the continued fraction of the regularized incomplete beta function.
+ * @param A First shape parameter.
+ * @param B Second shape parameter.
+ * @param X Evaluation point in [0, 1].
+ * @return The continued fraction value.
+ */
+static double BetaFraction(double A, double B, double X)
+{
+  const double Tiny = 1e-300;
+  double C = 1.0;
+  double D = 1.0 - (A + B) * X / (A + 1.0);
+  D = 1.0 / (std::fabs(D) < Tiny ? Tiny : D);
+  double Result = D;
+  for (int m = 1; m <= 300; ++m)
+  {
+    for (int Step = 0; Step < 2; ++Step)
+    {
+      double Numerator = Step == 0
+        ? m * (B - m) * X / ((A + 2 * m - 1) * (A + 2 * m))
+        : -(A + m) * (A + B + m) * X / ((A + 2 * m) * (A + 2 * m + 1));
+      D = 1.0 + Numerator * D;
+      D = 1.0 / (std::fabs(D) < Tiny ? Tiny : D);
+      C = 1.0 + Numerator / C;
+      C = std::fabs(C) < Tiny ? Tiny : C;
+      Result *= D * C;
+    }
+    if (std::fabs(D * C - 1.0) < 1e-15)
+      break;
+  }
+  return Result;
+}
+
+/**
+ * @brief Evaluates the regularized incomplete beta function I_x(a, b).
+ * @param A First shape parameter.
+ * @param B Second shape parameter.
+ * @param X Evaluation point in [0, 1].
+ * @return The function value.
+ */
+static double IncompleteBeta(double A, double B, double X)
+{
+  if (X <= 0.0)
+    return 0.0;
+  if (X >= 1.0)
+    return 1.0;
+  double Front = std::exp(std::lgamma(A + B) - std::lgamma(A) - std::lgamma(B) + A * std::log(X) + B * std::log(1.0 - X));
+  if (X < (A + 1.0) / (A + B + 2.0))
+    return Front * BetaFraction(A, B, X) / A;
+  return 1.0 - Front * BetaFraction(B, A, 1.0 - X) / B;
+}
+
+/**
+ * @brief Gets the two-sided tail probability of Student's t distribution.
+ * @param T The t statistic.
+ * @param Freedom Degrees of freedom.
+ * @return P(|t| >= T).
+ */
+static double TwoSidedP(double T, double Freedom)
+{
+  return IncompleteBeta(Freedom / 2.0, 0.5, Freedom / (Freedom + T * T));
+}
+
+/**
+ * @brief Finds the t value whose two-sided tail probability is Alpha.
+ * @param Alpha Tail probability.
+ * @param Freedom Degrees of freedom.
+ * @return The critical value.
+ */
+static double CriticalT(double Alpha, double Freedom)
+{
+  double Low = 0.0;
+  double High = 1e3;
+  for (int i = 0; i < 200; ++i)
+  {
+    double Middle = (Low + High) / 2.0;
+    if (TwoSidedP(Middle, Freedom) > Alpha)
+      Low = Middle;
+    else
+      High = Middle;
+  }
+  return (Low + High) / 2.0;
+}
+
+/**
+ * @brief Reads a results file.
+ * @param Path The file path.
+ * @return The results.
+ * @throws std::runtime_error if the file cannot be opened or parsed.
+ */
+static std::vector<CBenchResult> Load(const std::string& Path)
+{
+  std::ifstream In(Path);
+  if (!In)
+    throw std::runtime_error("Cannot open " + Path);
+  return CResultsReader::Read(In);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: BenchCompare baseline.json current.json [threshold] [confidence]\n";
+    return 2;
+  }
+  double Threshold = argc > 3 ? std::strtod(argv[3], nullptr) : 0.05;
+  double Confidence = argc > 4 ? std::strtod(argv[4], nullptr) : 0.99;
+  double Alpha = 1.0 - Confidence;
+
+  std::vector<CBenchResult> Baseline;
+  std::vector<CBenchResult> Current;
+  try
+  {
+    Baseline = Load(argv[1]);
+    Current = Load(argv[2]);
+  }
+  catch (const std::exception& Error)
+  {
+    std::cerr << Error.what() << "\n";
+    return 2;
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  size_t Regressions = 0;
+  size_t Missing = 0;
+  for (size_t b = 0; b < Baseline.size(); ++b)
+  {
+    const CBenchResult& Base = Baseline[b];
+    const CBenchResult* Match = nullptr;
+    for (size_t c = 0; c < Current.size() && !Match; ++c)
+      if (Current[c].Name == Base.Name)
+        Match = &Current[c];
+    if (!Match)
+    {
+      std::cout << Base.Name << ": MISSING from current run\n";
+      ++Missing;
+      continue;
+    }
+    if (Base.Samples.size() < 2 || Match->Samples.size() < 2 || Base.Mean() <= 0.0)
+    {
+      std::cout << Base.Name << ": needs at least two samples on each side\n";
+      continue;
+    }
+
+    double BaseError = Base.Variance() / Base.Samples.size();
+    double CurrentError = Match->Variance() / Match->Samples.size();
+    double Difference = Match->Mean() - Base.Mean();
+    double StandardError = std::sqrt(BaseError + CurrentError);
+    double P = 1.0;
+    double Margin = 0.0;
+    if (StandardError > 0.0)
+    {
+      double Freedom = (BaseError + CurrentError) * (BaseError + CurrentError)
+        / (BaseError * BaseError / (Base.Samples.size() - 1) + CurrentError * CurrentError / (Match->Samples.size() - 1));
+      P = TwoSidedP(Difference / StandardError, Freedom);
+      Margin = CriticalT(Alpha, Freedom) * StandardError;
+    }
+    else if (Difference != 0.0)
+      P = 0.0;
+
+    double Change = Difference / Base.Mean();
+    bool Significant = P < Alpha;
+    const char* Verdict = !Significant ? "unchanged" : Change > Threshold ? "REGRESSION" : Change < 0.0 ? "faster" : "slower, within threshold";
+    Regressions += Significant && Change > Threshold;
+
+    std::cout << Base.Name << ": " << Base.Mean() << " -> " << Match->Mean() << " " << Base.Unit << "  "
+      << std::showpos << 100.0 * Change << "% [" << 100.0 * (Difference - Margin) / Base.Mean() << "%, "
+      << 100.0 * (Difference + Margin) / Base.Mean() << "%]" << std::noshowpos << " p=" << std::setprecision(4) << P
+      << std::setprecision(2) << "  " << Verdict << "\n";
+  }
+
+  std::cout << Regressions << " regression" << (Regressions == 1 ? "" : "s") << " above " << 100.0 * Threshold
+    << "% at " << 100.0 * Confidence << "% confidence\n";
+  if (Missing)
+  {
+    std::cout << Missing << " benchmark" << (Missing == 1 ? "" : "s") << " missing from current run\n";
+    return 2;
+  }
+  return Regressions ? 1 : 0;
+}
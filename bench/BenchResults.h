@@ -0,0 +1,328 @@
+/**
+ * @file BenchResults.h
+ * @brief Benchmark results with repeated samples, and their JSON form used for baselines.
+ *
+ * A results file is a single object:
+ * { "benchmarks": [ { "name": "...", "unit": "ns/query", "samples": [ 12.1, 12.3 ] } ] }
+ * Lower values are always better. The reader accepts any JSON in this shape and
+ * ignores unknown keys.
+ */
+
+#pragma once
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @struct CBenchResult
+ * @brief One benchmark and the value measured in each repetition.
+ */
+struct CBenchResult
+{
+  std::string Name;             ///< Benchmark name, unique within a file.
+  std::string Unit;             ///< Unit of the samples, such as ns/query.
+  std::vector<double> Samples;  ///< One value per repetition.
+
+  /**
+   * @brief Gets the sample mean.
+   * @return The mean, or zero without samples.
+   */
+  double Mean() const
+  {
+    double Sum = 0.0;
+    for (size_t i = 0; i < Samples.size(); ++i)
+      Sum += Samples[i];
+    return Samples.empty() ? 0.0 : Sum / Samples.size();
+  }
+
+  /**
+   * @brief Gets the sample variance.
+   * @return The unbiased variance, or zero with fewer than two samples.
+   */
+  double Variance() const
+  {
+    if (Samples.size() < 2)
+      return 0.0;
+    double Average = Mean();
+    double Sum = 0.0;
+    for (size_t i = 0; i < Samples.size(); ++i)
+      Sum += (Samples[i] - Average) * (Samples[i] - Average);
+    return Sum / (Samples.size() - 1);
+  }
+};
+
+/**
+ * @brief Writes a JSON string literal, escaping quotes, backslashes and control characters.
+ * @param Out The stream to write to.
+ * @param Text The string.
+ */
+inline void WriteString(std::ostream& Out, const std::string& Text)
+{
+  static const char Hex[] = "0123456789abcdef";
+  Out << '"';
+  for (size_t i = 0; i < Text.size(); ++i)
+  {
+    unsigned char Character = static_cast<unsigned char>(Text[i]);
+    if (Character == '"' || Character == '\\')
+      Out << '\\' << Text[i];
+    else if (Character < 0x20)
+      Out << "\\u00" << Hex[Character >> 4] << Hex[Character & 15];
+    else
+      Out << Text[i];
+  }
+  Out << '"';
+}
+
+/**
+ * @brief Writes results as JSON.
+ * @param Out The stream to write to.
+ * @param Results The results.
+ */
+inline void WriteResults(std::ostream& Out, const std::vector<CBenchResult>& Results)
+{
+  Out.precision(17);
+  Out << "{\n  \"benchmarks\": [\n";
+  for (size_t r = 0; r < Results.size(); ++r)
+  {
+    Out << "    { \"name\": ";
+    WriteString(Out, Results[r].Name);
+    Out << ", \"unit\": ";
+    WriteString(Out, Results[r].Unit);
+    Out << ", \"samples\": [";
+    for (size_t i = 0; i < Results[r].Samples.size(); ++i)
+      Out << (i ? ", " : " ") << Results[r].Samples[i];
+    Out << " ] }" << (r + 1 < Results.size() ? "," : "") << "\n";
+  }
+  Out << "  ]\n}\n";
+}
+
+/**
+ * @class CResultsReader
+ * @brief Minimal recursive-descent JSON reader for results files.
+ */
+class CResultsReader
+{
+public:
+  /**
+   * @brief Parses a results file.
+   * @param In The stream to read.
+   * @return The results in file order.
+   * @throws std::runtime_error if the text is not valid JSON or lacks the benchmarks array.
+   */
+  static std::vector<CBenchResult> Read(std::istream& In)
+  {
+    std::string Text((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+    CResultsReader Reader(Text);
+    std::vector<CBenchResult> Results;
+    bool Found = false;
+    Reader.Expect('{');
+    if (!Reader.Accept('}'))
+    {
+      do
+      {
+        std::string Key = Reader.String();
+        Reader.Expect(':');
+        if (Key == "benchmarks")
+        {
+          Reader.Benchmarks(Results);
+          Found = true;
+        }
+        else
+          Reader.Skip();
+      } while (Reader.Accept(','));
+      Reader.Expect('}');
+    }
+    if (!Found)
+      throw std::runtime_error("Results file has no benchmarks array.");
+    return Results;
+  }
+
+private:
+  /**
+   * @brief The whole file.
+   */
+  std::string m_Text;
+
+  /**
+   * @brief Offset of the next unread character.
+   */
+  size_t m_Position = 0;
+
+  /**
+   * @brief Creates a reader over a file's text.
+   * @param Text The text.
+   */
+  explicit CResultsReader(const std::string& Text)
+    : m_Text(Text)
+  {
+  }
+
+  /**
+   * @brief Reads the benchmarks array.
+   * @param Results Receives the benchmarks.
+   */
+  void Benchmarks(std::vector<CBenchResult>& Results)
+  {
+    Expect('[');
+    if (Accept(']'))
+      return;
+    do
+    {
+      CBenchResult Result;
+      Expect('{');
+      if (!Accept('}'))
+      {
+        do
+        {
+          std::string Key = String();
+          Expect(':');
+          if (Key == "name")
+            Result.Name = String();
+          else if (Key == "unit")
+            Result.Unit = String();
+          else if (Key == "samples")
+          {
+            Expect('[');
+            if (!Accept(']'))
+            {
+              do
+                Result.Samples.push_back(Number());
+              while (Accept(','));
+              Expect(']');
+            }
+          }
+          else
+            Skip();
+        } while (Accept(','));
+        Expect('}');
+      }
+      Results.push_back(Result);
+    } while (Accept(','));
+    Expect(']');
+  }
+
+  /**
+   * @brief Skips over any value.
+   */
+  void Skip()
+  {
+    char Next = Peek();
+    if (Next == '"')
+      String();
+    else if (Next == '{' || Next == '[')
+    {
+      char Close = Next == '{' ? '}' : ']';
+      Expect(Next);
+      if (Accept(Close))
+        return;
+      do
+      {
+        if (Close == '}')
+        {
+          String();
+          Expect(':');
+        }
+        Skip();
+      } while (Accept(','));
+      Expect(Close);
+    }
+    else if (Next == 't' || Next == 'f' || Next == 'n')
+    {
+      while (m_Position < m_Text.size() && std::isalpha(static_cast<unsigned char>(m_Text[m_Position])))
+        ++m_Position;
+    }
+    else
+      Number();
+  }
+
+  /**
+   * @brief Reads a string. \\uXXXX escapes are decoded for single-byte characters;
+   * other escaped characters are kept literally.
+   * @return The string.
+   */
+  std::string String()
+  {
+    Expect('"');
+    std::string Value;
+    while (m_Position < m_Text.size() && m_Text[m_Position] != '"')
+    {
+      if (m_Text[m_Position] == '\\' && m_Position + 1 < m_Text.size())
+      {
+        ++m_Position;
+        if (m_Text[m_Position] == 'u' && m_Position + 4 < m_Text.size())
+        {
+          unsigned long Code = std::strtoul(m_Text.substr(m_Position + 1, 4).c_str(), nullptr, 16);
+          if (Code < 0x100)
+          {
+            Value += static_cast<char>(Code);
+            m_Position += 5;
+            continue;
+          }
+        }
+      }
+      Value += m_Text[m_Position++];
+    }
+    if (m_Position == m_Text.size())
+      throw std::runtime_error("Unterminated string in results file.");
+    ++m_Position;
+    return Value;
+  }
+
+  /**
+   * @brief Reads a number.
+   * @return The value.
+   */
+  double Number()
+  {
+    Peek();
+    const char* Begin = m_Text.c_str() + m_Position;
+    char* End = nullptr;
+    double Value = std::strtod(Begin, &End);
+    if (End == Begin)
+      throw std::runtime_error("Expected a number at offset " + std::to_string(m_Position) + " of results file.");
+    m_Position += End - Begin;
+    return Value;
+  }
+
+  /**
+   * @brief Skips whitespace and returns the next character without consuming it.
+   * @return The character, or NUL at the end.
+   */
+  char Peek()
+  {
+    while (m_Position < m_Text.size() && std::isspace(static_cast<unsigned char>(m_Text[m_Position])))
+      ++m_Position;
+    return m_Position < m_Text.size() ? m_Text[m_Position] : '\0';
+  }
+
+  /**
+   * @brief Consumes a character if it comes next.
+   * @param Token The character.
+   * @return True if it was consumed.
+   */
+  bool Accept(char Token)
+  {
+    if (Peek() != Token)
+      return false;
+    ++m_Position;
+    return true;
+  }
+
+  /**
+   * @brief Consumes a character that must come next.
+   * @param Token The character.
+   * @throws std::runtime_error if something else comes next.
+   */
+  void Expect(char Token)
+  {
+    if (!Accept(Token))
+      throw std::runtime_error(std::string("Expected '") + Token + "' at offset " + std::to_string(m_Position)
+        + " of results file.");
+  }
+};
@@ -0,0 +1,139 @@
+/**
+ * @file CalibrationBaseline.cpp
+ * @brief Runs the CCalibrationMap lookup and build benchmarks repeatedly and writes the results as JSON.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. CalibrationBaseline.cpp -pthread -o CalibrationBaseline
+ * Usage: CalibrationBaseline [output.json] [repetitions] [points] [queries]
+ *
+ * Store the output of a known-good build as a baseline and compare later runs
+ * against it with BenchCompare. Each repetition rebuilds its inputs, so samples
+ * are independent apart from machine state. Maps and queries come from
+ * CalibrationWorkload.h with fixed seeds, so every run measures the same data.
+ */
+
+#include "../CCalibrationFile.h"
+#include "BenchResults.h"
+#include "CalibrationWorkload.h"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+
+/**
+ * @brief Times an action and returns nanoseconds per item.
+ * @param Items Number of items the action processes.
+ * @param Action The action.
+ * @return Elapsed nanoseconds divided by Items.
+ */
+static double NanosecondsPer(size_t Items, const std::function<void()>& Action)
+{
+  auto Start = std::chrono::steady_clock::now();
+  Action();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / Items;
+}
+
+int main(int argc, char** argv)
+{
+  std::string Output = argc > 1 ? argv[1] : "";
+  size_t Repetitions = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+  size_t Points = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100000;
+  size_t QueryCount = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 1000000;
+
+  std::vector<CBenchResult> Results;
+  auto Record = [&](const std::string& Name, const std::string& Unit, double Value)
+  {
+    for (size_t i = 0; i < Results.size(); ++i)
+    {
+      if (Results[i].Name == Name)
+      {
+        Results[i].Samples.push_back(Value);
+        return;
+      }
+    }
+    Results.push_back(CBenchResult{ Name, Unit, std::vector<double>(1, Value) });
+  };
+
+  CCalibrationWorkload::MapOptions Shape;
+  Shape.Points = Points;
+  CCalibrationMap Source = CCalibrationWorkload::Map(Shape);
+  std::vector<double> Nominals;
+  std::vector<double> Calibrated;
+  for (auto it = Source.GetMap().begin(); it != Source.GetMap().end(); ++it)
+  {
+    Nominals.push_back(it->first);
+    Calibrated.push_back(it->first - it->second);
+  }
+
+  CCalibrationWorkload::QueryOptions Stream;
+  Stream.Count = QueryCount;
+  std::vector<double> Queries = CCalibrationWorkload::Queries(Source, Stream);
+  Stream.Pattern = CCalibrationWorkload::QueryPattern::Sweep;
+  std::vector<double> Sorted = CCalibrationWorkload::Queries(Source, Stream);
+  std::vector<double> Corrected(QueryCount);
+
+  for (size_t Repetition = 0; Repetition < Repetitions; ++Repetition)
+  {
+    CCalibrationMap Map;
+    Record("build add points", "ns/point", NanosecondsPer(Points, [&]()
+    {
+      for (size_t i = 0; i < Points; ++i)
+        Map.AddPoint(Nominals[i], Calibrated[i]);
+    }));
+
+    std::stringstream Binary;
+    CCalibrationFile::WriteBinary(Binary, Map);
+    Record("build read binary", "ns/point", NanosecondsPer(Points, [&]()
+    {
+      Binary.seekg(0);
+      CCalibrationFile::ReadBinary(Binary);
+    }));
+
+    double Sum = 0.0;
+    Record("lookup tree random", "ns/query", NanosecondsPer(QueryCount, [&]()
+    {
+      for (size_t i = 0; i < QueryCount; ++i)
+        Sum += Map.ErrorValue(Queries[i]);
+    }));
+
+    Record("build freeze", "ns/point", NanosecondsPer(Points, [&]() { Map.Freeze(); }));
+    Record("lookup frozen random", "ns/query", NanosecondsPer(QueryCount, [&]()
+    {
+      for (size_t i = 0; i < QueryCount; ++i)
+        Sum += Map.ErrorValue(Queries[i]);
+    }));
+    Record("lookup frozen sweep batch", "ns/query", NanosecondsPer(QueryCount, [&]()
+    {
+      Map.CorrectedPoints(Sorted.data(), Corrected.data(), QueryCount);
+    }));
+
+    CCalibrationMap::FreezeOptions Options;
+    Options.Merge = CCalibrationMap::MergeMode::Tolerance;
+    Options.Tolerance = 1e-6;
+    Options.ErrorBudget = 1e-6;
+    Record("build freeze merged float", "ns/point", NanosecondsPer(Points, [&]() { Map.Freeze(Options); }));
+    Record("lookup frozen merged float random", "ns/query", NanosecondsPer(QueryCount, [&]()
+    {
+      for (size_t i = 0; i < QueryCount; ++i)
+        Sum += Map.ErrorValue(Queries[i]);
+    }));
+
+    if (Sum == 0.0)
+      std::cerr << "checksum " << Sum << "\n";
+    std::cerr << "repetition " << Repetition + 1 << " of " << Repetitions << "\n";
+  }
+
+  if (Output.empty())
+    WriteResults(std::cout, Results);
+  else
+  {
+    std::ofstream Out(Output);
+    WriteResults(Out, Results);
+    if (!Out)
+    {
+      std::cerr << "Cannot write " << Output << "\n";
+      return 2;
+    }
+  }
+  return 0;
+}
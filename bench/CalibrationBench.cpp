@@ -0,0 +1,231 @@
+/**
+ * @file CalibrationBench.cpp
+ * @brief Lookup and memory benchmarks for CCalibrationMap and its models.
+ *
+ * Build: g++ -O2 -std=c++17 -pthread -I.. CalibrationBench.cpp -o CalibrationBench
+ * Usage: CalibrationBench [points] [queries] [uniform|irregular] [noise]
+ *
+ * Maps and query streams come from CalibrationWorkload.h.
+ */
+
+#include "../CLinearResidualMap.h"
+#include "../CNumaReplicatedMap.h"
+#include "../CCorrectionPipeline.h"
+#include "CalibrationWorkload.h"
+#include "../CPeriodicErrorModel.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+/**
+ * @brief Times a lookup loop and prints nanoseconds per query.
+ * @param Name Benchmark name.
+ * @param Queries The nominal values to look up.
+ * @param Lookup The lookup under test.
+ */
+static void Run(const std::string& Name, const std::vector<double>& Queries, const std::function<double(double)>& Lookup)
+{
+  double Sum = 0.0;
+  auto Start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < Queries.size(); ++i)
+    Sum += Lookup(Queries[i]);
+  double Elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+  std::cout << Name << "\t" << Elapsed / Queries.size() << " ns/query\t(checksum " << Sum << ")\n";
+}
+
+/**
+ * @brief Prints a layout's memory footprint.
+ * @param Name Layout name.
+ * @param Footprint Bytes per representation.
+ * @param Points Breakpoints in the source map.
+ */
+static void Report(const std::string& Name, const CMemoryFootprint& Footprint, size_t Points)
+{
+  std::cout << Name << "\t" << Footprint.Total() << " bytes\t" << double(Footprint.Total()) / Points << " bytes/point"
+    << "\t(tree " << Footprint.TreeBytes << ", frozen " << Footprint.FrozenBytes << ", compressed "
+    << Footprint.CompressedBytes << ", coefficients " << Footprint.CoefficientBytes << ", cache "
+    << Footprint.CacheBytes << ", index " << Footprint.IndexBytes << ")\n";
+}
+
+/**
+ * @brief The lookup ErrorValue() used before snapping: an exact find, then a second search on a miss.
+ */
+static double FindThenSearch(const std::map<double, double>& Map, double Nominal)
+{
+  auto it = Map.find(Nominal);
+  if (it != Map.end())
+    return it->second;
+  auto upper = Map.upper_bound(Nominal);
+  auto lower = std::prev(upper);
+  return lower->second + (Nominal - lower->first) * (upper->second - lower->second) / (upper->first - lower->first);
+}
+
+int main(int argc, char** argv)
+{
+  size_t Points = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  size_t QueryCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+
+  CCalibrationWorkload::MapOptions Shape;
+  Shape.Points = Points;
+  Shape.Irregular = argc > 3 && std::string(argv[3]) == "irregular";
+  Shape.Noise = argc > 4 ? std::strtod(argv[4], nullptr) : 0.0;
+  CCalibrationMap Map = CCalibrationWorkload::Map(Shape);
+  double Last = Map.GetMap().rbegin()->first;
+
+  CCalibrationWorkload::QueryOptions Stream;
+  Stream.Count = QueryCount;
+  const CCalibrationWorkload::QueryPattern Patterns[] = { CCalibrationWorkload::QueryPattern::Random,
+    CCalibrationWorkload::QueryPattern::Setpoints, CCalibrationWorkload::QueryPattern::Sweep,
+    CCalibrationWorkload::QueryPattern::Dwell };
+  std::vector<std::vector<double>> Streams;
+  for (CCalibrationWorkload::QueryPattern Pattern : Patterns)
+  {
+    Stream.Pattern = Pattern;
+    Streams.push_back(CCalibrationWorkload::Queries(Map, Stream));
+  }
+  const std::vector<double>& RandomQueries = Streams[0];
+  const std::vector<double>& ComputedSetpoints = Streams[1];
+  std::mt19937_64 Random(42);
+
+  const std::map<double, double>& Tree = Map.GetMap();
+  std::cout << "== Search cost, " << Points << (Shape.Irregular ? " irregular" : " uniform") << " points ==\n";
+  for (size_t Workload = 0; Workload < Streams.size(); ++Workload)
+  {
+    const std::vector<double>& Queries = Streams[Workload];
+    std::string Suffix = std::string(" ") + CCalibrationWorkload::Name(Patterns[Workload]);
+
+    Map.SetSnapTolerance(0.0);
+    Run("tree find+search" + Suffix, Queries, [&](double x) { return FindThenSearch(Tree, x); });
+    Run("tree single search" + Suffix, Queries, [&](double x) { return Map.ErrorValue(x); });
+    Map.SetSnapTolerance(1e-8);
+    Run("tree snap 1e-8" + Suffix, Queries, [&](double x) { return Map.ErrorValue(x); });
+    Map.Freeze();
+    Map.SetSnapTolerance(0.0);
+    Run("frozen" + Suffix, Queries, [&](double x) { return Map.ErrorValue(x); });
+    Map.SetSnapTolerance(1e-8);
+    Run("frozen snap 1e-8" + Suffix, Queries, [&](double x) { return Map.ErrorValue(x); });
+    Map.Thaw();
+  }
+
+  std::cout << "== Snap accuracy impact on computed setpoints ==\n";
+  const double Tolerances[] = { 1e-12, 1e-9, 1e-6, 1e-3 };
+  for (double Tolerance : Tolerances)
+  {
+    double Worst = 0.0;
+    size_t Snapped = 0;
+    for (size_t i = 0; i < ComputedSetpoints.size(); ++i)
+    {
+      Map.SetSnapTolerance(0.0);
+      double Exact = Map.ErrorValue(ComputedSetpoints[i]);
+      Map.SetSnapTolerance(Tolerance);
+      double Snap = Map.ErrorValue(ComputedSetpoints[i]);
+      Worst = std::max(Worst, std::fabs(Snap - Exact));
+      Snapped += Snap != Exact;
+    }
+    std::cout << "tolerance " << Tolerance << "\tworst deviation " << Worst << "\tchanged " << Snapped << " of "
+      << ComputedSetpoints.size() << "\n";
+  }
+
+  std::cout << "== Setpoint cache, 300 distinct positions ==\n";
+  std::vector<double> Positions(300);
+  for (size_t i = 0; i < Positions.size(); ++i)
+    Positions[i] = RandomQueries[i];
+  std::vector<double> Revisits(QueryCount);
+  for (size_t i = 0; i < QueryCount; ++i)
+    Revisits[i] = Positions[Random() % Positions.size()];
+
+  Map.SetSnapTolerance(0.0);
+  Run("tree uncached", Revisits, [&](double x) { return Map.CorrectedPoint(x); });
+  Map.EnableCache(1024);
+  Run("tree cached 1024", Revisits, [&](double x) { return Map.CorrectedPoint(x); });
+  std::cout << "hit rate " << Map.GetCacheStats().HitRate() << "\n";
+  Map.Freeze();
+  Map.EnableCache(0);
+  Run("frozen uncached", Revisits, [&](double x) { return Map.CorrectedPoint(x); });
+  Map.EnableCache(1024);
+  Run("frozen cached 1024", Revisits, [&](double x) { return Map.CorrectedPoint(x); });
+  std::cout << "hit rate " << Map.GetCacheStats().HitRate() << "\n";
+  Map.EnableCache(0);
+  Map.Thaw();
+
+  std::cout << "== Counts to corrected mm, " << QueryCount << " samples ==\n";
+  Map.Freeze();
+  std::vector<double> Counts(QueryCount);
+  std::vector<double> Output(QueryCount);
+  for (size_t i = 0; i < QueryCount; ++i)
+    Counts[i] = std::floor(i * (Last - 1.0) / QueryCount * 1000.0);
+
+  auto Start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < QueryCount; ++i)
+    Output[i] = Counts[i] * 0.001;
+  Map.CorrectedPoints(Output.data(), Output.data(), QueryCount);
+  for (size_t i = 0; i < QueryCount; ++i)
+    Output[i] = Output[i] + 0.5;
+  for (size_t i = 0; i < QueryCount; ++i)
+    Output[i] = Output[i] * 25.4;
+  double Separate = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+  double Check = Output[QueryCount / 2];
+  std::cout << "separate passes\t" << Separate / QueryCount << " ns/sample\n";
+
+  CCorrectionPipeline Pipeline;
+  Pipeline.Scale(0.001).Correct(Map).Offset(0.5).Scale(25.4);
+  Start = std::chrono::steady_clock::now();
+  Pipeline.Run(Counts.data(), Output.data(), QueryCount);
+  double Fused = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+  std::cout << "fused pipeline\t" << Fused / QueryCount << " ns/sample\t(" << Pipeline.StageCount()
+    << " stages, deviation " << std::fabs(Output[QueryCount / 2] - Check) << ")\n";
+  Map.Thaw();
+
+  std::cout << "== Memory footprint, " << Points << " points ==\n";
+  Map.SetSnapTolerance(0.0);
+  Report("tree", Map.MemoryFootprint(), Points);
+  Map.Freeze();
+  Report("tree + frozen", Map.MemoryFootprint(), Points);
+
+  CCalibrationMap::FreezeOptions Options;
+  Options.Merge = CCalibrationMap::MergeMode::Tolerance;
+  Options.Tolerance = 1e-6;
+  Map.Freeze(Options);
+  Report("tree + frozen merged 1e-6", Map.MemoryFootprint(), Points);
+
+  Options = CCalibrationMap::FreezeOptions();
+  Options.ErrorBudget = 1e-6;
+  Map.Freeze(Options);
+  Report("tree + frozen float", Map.MemoryFootprint(), Points);
+
+  CLinearResidualMap<int16_t> Int16Model;
+  Int16Model.Fit(Map);
+  Report("linear + int16 residuals", Int16Model.MemoryFootprint(), Points);
+
+  CLinearResidualMap<CHalfFloat> HalfModel;
+  HalfModel.Fit(Map);
+  Report("linear + half residuals", HalfModel.MemoryFootprint(), Points);
+
+  CPeriodicErrorModel Periodic;
+  Options = CCalibrationMap::FreezeOptions();
+  Options.Merge = CCalibrationMap::MergeMode::Tolerance;
+  Options.Tolerance = 1e-6;
+  Periodic.Fit(Map, 2.0 * 3.14159265358979323846, 8, 64, Options);
+  Report("fourier + merged remainder", Periodic.MemoryFootprint(), Points);
+
+  Map.Freeze();
+  CNumaReplicatedMap Replicated(Map);
+  std::cout << "== NUMA replicas, " << Replicated.NodeCount() << " nodes ==\n";
+  if (Replicated.NodeCount() < 2)
+    std::cout << "single node, skipped\n";
+  for (size_t Node = 0; Replicated.NodeCount() > 1 && Node < Replicated.NodeCount(); ++Node)
+  {
+    std::thread Reader([&, Node]()
+    {
+      Replicated.BindToNode(0);
+      const CCalibrationMap::FrozenTable& Table = Replicated.Replica(Node);
+      std::string Name = Node == 0 ? "node 0 reading local replica" : "node 0 reading node " + std::to_string(Node);
+      if (!Replicated.IsNodeLocal(Node))
+        Name += " (copied unbound)";
+      Run(Name, RandomQueries, [&](double x) { size_t Cursor = 0; return Table.ErrorValue(x, Cursor, 0.0); });
+    });
+    Reader.join();
+  }
+  return 0;
+}
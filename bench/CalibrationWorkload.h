@@ -0,0 +1,211 @@
+/**
+ * @file CalibrationWorkload.h
+ * @brief Generates synthetic calibration maps and query streams for the benchmarks.
+ *
+ * Maps combine the error sources seen on real axes: a linear scale error, a
+ * periodic pitch error from the lead screw or encoder, random measurement noise
+ * and a backlash offset. Breakpoints can be evenly spaced or jittered. Query
+ * streams model random access, computed setpoints that land on breakpoints, a
+ * back-and-forth sweep, and an indexer that dwells on a few hundred positions.
+ * Every generator is seeded, so the same options always give the same data.
+ */
+
+#pragma once
+#include "../CCalibrationMap.h"
+#include <random>
+
+/**
+ * @class CCalibrationWorkload
+ * @brief Seeded generators for calibration maps and query streams.
+ */
+class CCalibrationWorkload
+{
+public:
+  /**
+   * @brief Shape of a generated map.
+   */
+  struct MapOptions
+  {
+    size_t Points = 100000;                  ///< Number of breakpoints.
+    double Spacing = 0.1;                    ///< Mean distance between breakpoints.
+    bool Irregular = false;                  ///< Jitter each inner breakpoint by up to 45% of the spacing.
+    double ScaleError = 2e-5;                ///< Linear error per unit of travel.
+    double PitchAmplitude = 1e-3;            ///< Amplitude of the periodic pitch error.
+    double PitchPeriod = 6.283185307179586;  ///< Period of the pitch error in nominal units.
+    double Noise = 0.0;                      ///< Standard deviation of measurement noise.
+    double Backlash = 0.0;                   ///< Lost motion; the map is for forward approach, offset by half of it.
+    uint64_t Seed = 1;                       ///< Random seed.
+  };
+
+  /**
+   * @brief Selects a query stream.
+   */
+  enum class QueryPattern
+  {
+    Random,     ///< Uniform over the calibrated range.
+    Setpoints,  ///< Breakpoints plus a rounding-sized perturbation, as computed setpoints are.
+    Sweep,      ///< Back and forth across the range in small steps.
+    Dwell       ///< Long dwells on a few positions joined by short moves.
+  };
+
+  /**
+   * @brief Shape of a generated query stream.
+   */
+  struct QueryOptions
+  {
+    QueryPattern Pattern = QueryPattern::Random;  ///< Stream type.
+    size_t Count = 1000000;                       ///< Number of queries.
+    size_t Passes = 4;                            ///< Sweep: traversals of the full range.
+    size_t DwellPositions = 300;                  ///< Dwell: distinct positions visited.
+    size_t DwellLength = 200;                     ///< Dwell: mean queries per dwell.
+    size_t MoveLength = 20;                       ///< Dwell: queries on the move between positions.
+    uint64_t Seed = 2;                            ///< Random seed.
+  };
+
+  /**
+   * @brief Gets the noise-free error at a nominal value.
+   * @param Options The map shape.
+   * @param Nominal The nominal value.
+   * @return The error value.
+   */
+  static double ErrorAt(const MapOptions& Options, double Nominal)
+  {
+    return Options.ScaleError * Nominal + Options.PitchAmplitude * std::sin(2.0 * 3.141592653589793 * Nominal / Options.PitchPeriod)
+      + Options.Backlash / 2.0;
+  }
+
+  /**
+   * @brief Generates a calibration map.
+   *
+   * Points are built in order and handed over in one SetMap(), so maps of several
+   * million points take about a second.
+   * @param Options The map shape.
+   * @return The map.
+   * @throws std::invalid_argument if fewer than two points or a non-positive spacing are requested.
+   */
+  static CCalibrationMap Map(const MapOptions& Options)
+  {
+    if (Options.Points < 2 || !(Options.Spacing > 0.0))
+      throw std::invalid_argument("A workload map needs at least two points and a positive spacing.");
+
+    std::mt19937_64 Random(Options.Seed);
+    std::uniform_real_distribution<double> Jitter(-0.45, 0.45);
+    std::normal_distribution<double> Noise(0.0, Options.Noise > 0.0 ? Options.Noise : 1.0);
+
+    std::map<double, double> Points;
+    for (size_t i = 0; i < Options.Points; ++i)
+    {
+      double Nominal = i * Options.Spacing;
+      if (Options.Irregular && i > 0 && i + 1 < Options.Points)
+        Nominal += Jitter(Random) * Options.Spacing;
+      double Error = ErrorAt(Options, Nominal);
+      if (Options.Noise > 0.0)
+        Error += Noise(Random);
+      Points.emplace_hint(Points.end(), Nominal, Error);
+    }
+
+    CCalibrationMap Map;
+    Map.SetMap(std::move(Points));
+    return Map;
+  }
+
+  /**
+   * @brief Generates a query stream within a map's calibrated range.
+   * @param Map The map the queries are for.
+   * @param Options The stream shape.
+   * @return The nominal values to query.
+   * @throws std::invalid_argument if the map has fewer than two points.
+   */
+  static std::vector<double> Queries(CCalibrationMap& Map, const QueryOptions& Options)
+  {
+    const std::map<double, double>& Points = Map.GetMap();
+    if (Points.size() < 2)
+      throw std::invalid_argument("Queries need a map with at least two points.");
+    double First = Points.begin()->first;
+    double Last = Points.rbegin()->first;
+
+    std::mt19937_64 Random(Options.Seed);
+    std::uniform_real_distribution<double> Uniform(First, Last);
+    std::vector<double> Queries;
+    Queries.reserve(Options.Count);
+
+    switch (Options.Pattern)
+    {
+    case QueryPattern::Random:
+      while (Queries.size() < Options.Count)
+        Queries.push_back(Uniform(Random));
+      break;
+
+    case QueryPattern::Setpoints:
+    {
+      std::vector<double> Breakpoints;
+      Breakpoints.reserve(Points.size());
+      for (auto it = std::next(Points.begin()); it != std::prev(Points.end()); ++it)
+        Breakpoints.push_back(it->first);
+      if (Breakpoints.empty())
+        Breakpoints.push_back((First + Last) / 2.0);
+      std::uniform_int_distribution<size_t> Pick(0, Breakpoints.size() - 1);
+      std::uniform_real_distribution<double> Rounding(-1e-9, 1e-9);
+      while (Queries.size() < Options.Count)
+        Queries.push_back(Breakpoints[Pick(Random)] + Rounding(Random));
+      break;
+    }
+
+    case QueryPattern::Sweep:
+    {
+      double Range = Last - First;
+      double Step = Range * std::max<size_t>(Options.Passes, 1) / std::max<size_t>(Options.Count, 1);
+      double Position = 0.0;
+      while (Queries.size() < Options.Count)
+      {
+        double Folded = std::fmod(Position, 2.0 * Range);
+        Queries.push_back(First + (Folded <= Range ? Folded : 2.0 * Range - Folded));
+        Position += Step;
+      }
+      break;
+    }
+
+    case QueryPattern::Dwell:
+    {
+      std::vector<double> Positions(std::max<size_t>(Options.DwellPositions, 1));
+      for (size_t i = 0; i < Positions.size(); ++i)
+        Positions[i] = Uniform(Random);
+      std::uniform_int_distribution<size_t> Pick(0, Positions.size() - 1);
+      std::geometric_distribution<size_t> Length(1.0 / std::max<size_t>(Options.DwellLength, 1));
+      double Current = Positions[Pick(Random)];
+      while (Queries.size() < Options.Count)
+      {
+        for (size_t i = Length(Random) + 1; i > 0 && Queries.size() < Options.Count; --i)
+          Queries.push_back(Current);
+        double Target = Positions[Pick(Random)];
+        for (size_t i = 1; i <= Options.MoveLength && Queries.size() < Options.Count; ++i)
+          Queries.push_back(Current + (Target - Current) * i / (Options.MoveLength + 1));
+        Current = Target;
+      }
+      break;
+    }
+    }
+    return Queries;
+  }
+
+  /**
+   * @brief Gets the name of a query pattern.
+   * @param Pattern The pattern.
+   * @return A lower-case name.
+   */
+  static const char* Name(QueryPattern Pattern)
+  {
+    switch (Pattern)
+    {
+    case QueryPattern::Random:
+      return "random";
+    case QueryPattern::Setpoints:
+      return "setpoints";
+    case QueryPattern::Sweep:
+      return "sweep";
+    case QueryPattern::Dwell:
+      return "dwell";
+    }
+    return "unknown";
+  }
+};
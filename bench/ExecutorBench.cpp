@@ -0,0 +1,109 @@
+/**
+ * @file ExecutorBench.cpp
+ * @brief Compares work stealing with a static split for heterogeneous correction jobs.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. ExecutorBench.cpp -pthread -o ExecutorBench
+ * Usage: ExecutorBench [threads] [jobs]
+ *
+ * Maps range from eight points to over a hundred thousand, and recordings from a thousand values
+ * to a few million, so per-job cost varies by several orders of magnitude. The
+ * static split hands each thread a contiguous block of jobs with an equal share of
+ * the values, which is the best a scheduler without cost estimates can do.
+ */
+
+#include "../CCalibrationExecutor.h"
+#include "CalibrationWorkload.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+static double Seconds(std::chrono::steady_clock::time_point Start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/**
+ * @brief Runs jobs on a fixed number of threads, each taking a contiguous block with an equal share of values.
+ * @param Jobs The jobs to run.
+ * @param Threads Number of threads.
+ */
+static void RunStatic(const std::vector<CCalibrationExecutor::Job>& Jobs, size_t Threads)
+{
+  size_t Total = 0;
+  for (size_t i = 0; i < Jobs.size(); ++i)
+    Total += Jobs[i].Count;
+
+  std::vector<std::thread> Workers;
+  size_t Begin = 0;
+  for (size_t t = 0; t < Threads; ++t)
+  {
+    size_t End = Begin;
+    size_t Share = 0;
+    while (End < Jobs.size() && (Share < Total / Threads || t + 1 == Threads))
+      Share += Jobs[End++].Count;
+    Workers.emplace_back([&Jobs, Begin, End]()
+    {
+      for (size_t i = Begin; i < End; ++i)
+        Jobs[i].Map->CorrectedPoints(Jobs[i].Nominals, Jobs[i].Corrected, Jobs[i].Count);
+    });
+    Begin = End;
+  }
+  for (size_t i = 0; i < Workers.size(); ++i)
+    Workers[i].join();
+}
+
+int main(int argc, char** argv)
+{
+  size_t Threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+  size_t JobCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+  Threads = std::max<size_t>(Threads, 1);
+
+  std::mt19937_64 Random(7);
+  std::vector<CCalibrationMap> Maps;
+  for (size_t m = 0; m < 8; ++m)
+  {
+    CCalibrationWorkload::MapOptions Shape;
+    Shape.Points = size_t(8) << (2 * m);
+    Shape.Spacing = 1000.0 / (Shape.Points - 1);
+    Shape.Irregular = true;
+    Shape.Seed = m + 1;
+    Maps.push_back(CCalibrationWorkload::Map(Shape));
+    if (m % 2)
+      Maps[m].Freeze();
+  }
+
+  std::lognormal_distribution<double> Length(10.0, 1.5);
+  std::vector<std::vector<double>> Recordings(JobCount);
+  std::vector<std::vector<double>> Output(JobCount);
+  std::vector<CCalibrationExecutor::Job> Jobs;
+  size_t Total = 0;
+  for (size_t j = 0; j < JobCount; ++j)
+  {
+    CCalibrationMap& Map = Maps[Random() % Maps.size()];
+    CCalibrationWorkload::QueryOptions Stream;
+    Stream.Count = std::min<size_t>(size_t(Length(Random)) + 1000, 4000000);
+    Stream.Seed = j + 1;
+    Recordings[j] = CCalibrationWorkload::Queries(Map, Stream);
+    Output[j].resize(Stream.Count);
+    Total += Stream.Count;
+    Jobs.push_back(CCalibrationExecutor::Job{ &Map, Recordings[j].data(), Output[j].data(), Stream.Count });
+  }
+  std::cout << JobCount << " jobs, " << Total << " values, " << Threads << " threads\n";
+
+  auto Start = std::chrono::steady_clock::now();
+  RunStatic(Jobs, Threads);
+  double Static = Seconds(Start);
+  std::cout << "static split\t" << Static << " s\t" << Static * 1e9 / Total << " ns/value\n";
+
+  const size_t Grains[] = { 512, 2048, 16384 };
+  for (size_t Grain : Grains)
+  {
+    CCalibrationExecutor Executor(Threads, Grain);
+    Start = std::chrono::steady_clock::now();
+    Executor.Run(Jobs);
+    double Stealing = Seconds(Start);
+    std::cout << "work stealing, grain " << Grain << "\t" << Stealing << " s\t" << Stealing * 1e9 / Total
+      << " ns/value\t(" << Static / Stealing << "x)\n";
+  }
+  return 0;
+}
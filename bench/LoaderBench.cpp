@@ -0,0 +1,68 @@
+/**
+ * @file LoaderBench.cpp
+ * @brief Compares sequential, thread-pool and io_uring loading of many small calibration files.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. LoaderBench.cpp -pthread -o LoaderBench
+ * Usage: LoaderBench [directory] [files] [points per file] [sequential|threaded|io_uring]
+ *
+ * The files are written once and then read by each loader in turn. For cold-cache
+ * numbers, drop the page cache (echo 3 > /proc/sys/vm/drop_caches) between runs
+ * and pass a single loader name as the fourth argument.
+ */
+
+#include "../CCalibrationLoader.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static double Seconds(std::chrono::steady_clock::time_point Start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+int main(int argc, char** argv)
+{
+  std::string Directory = argc > 1 ? argv[1] : "/tmp";
+  size_t Files = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+  size_t Points = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 200;
+  std::string Only = argc > 4 ? argv[4] : "";
+
+  std::vector<std::string> Paths;
+  for (size_t f = 0; f < Files; ++f)
+  {
+    Paths.push_back(Directory + "/calibration_" + std::to_string(f) + ".txt");
+    std::ofstream Out(Paths.back());
+    Out.precision(17);
+    Out << "# Nominal Calibrated\n";
+    for (size_t p = 0; p < Points; ++p)
+      Out << p * 0.5 << " " << p * 0.5 * (1.0 - 1e-5 * (f % 7)) << "\n";
+  }
+
+  size_t Checksum = 0;
+  auto Run = [&](const char* Name, std::vector<CCalibrationMap> (*Loader)(const std::vector<std::string>&))
+  {
+    if (!Only.empty() && Only != Name)
+      return;
+    auto Start = std::chrono::steady_clock::now();
+    std::vector<CCalibrationMap> Maps = Loader(Paths);
+    double Elapsed = Seconds(Start);
+    for (size_t i = 0; i < Maps.size(); ++i)
+      Checksum += Maps[i].GetMap().size();
+    std::cout << Name << "\t" << Elapsed * 1e3 << " ms\t" << Files / Elapsed << " files/s\n";
+  };
+
+  Run("sequential", &CCalibrationLoader::LoadSequential);
+  Run("threaded", [](const std::vector<std::string>& P) { return CCalibrationLoader::LoadThreaded(P); });
+  Run("io_uring", [](const std::vector<std::string>& P)
+  {
+    std::vector<CCalibrationMap> Maps;
+    if (!CCalibrationLoader::LoadUring(P, Maps))
+      std::cout << "io_uring unavailable, ";
+    return Maps;
+  });
+
+  for (size_t f = 0; f < Paths.size(); ++f)
+    std::remove(Paths[f].c_str());
+  std::cout << "points loaded: " << Checksum << "\n";
+  return 0;
+}
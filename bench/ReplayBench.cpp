@@ -0,0 +1,158 @@
+/**
+ * @file ReplayBench.cpp
+ * @brief Replays a captured query trace against each lookup engine and reports throughput and latency.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. ReplayBench.cpp -pthread -o ReplayBench
+ * Usage: ReplayBench trace.cqry map.txt [engine...]
+ *
+ * Record a trace in the application with CCalibrationMap::SetCapture(). The map
+ * file is text, or the binary format when it ends in ".bin". Engines are tree,
+ * frozen, merged, float, cached and linear; all run by default. Each engine
+ * replays the same sequence twice: once back to back for throughput, and once
+ * timing every query for the latency distribution, which includes the clock
+ * overhead reported on the first line. Capture timing is not reproduced.
+ */
+
+#include "../CCalibrationFile.h"
+#include "../CLinearResidualMap.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+/**
+ * @brief Replays a trace through one engine and prints its results.
+ * @param Name Engine name.
+ * @param Trace The captured queries.
+ * @param Lookup The engine's correction.
+ */
+static void Replay(const std::string& Name, const CQueryTrace& Trace, const std::function<double(double)>& Lookup)
+{
+  const std::vector<double>& Queries = Trace.Nominals;
+  double Sum = 0.0;
+  size_t Failed = 0;
+  auto Start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < Queries.size(); ++i)
+  {
+    try
+    {
+      Sum += Lookup(Queries[i]);
+    }
+    catch (const std::exception&)
+    {
+      ++Failed;
+    }
+  }
+  double Elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+  std::vector<double> Latencies(Queries.size());
+  for (size_t i = 0; i < Queries.size(); ++i)
+  {
+    auto Before = std::chrono::steady_clock::now();
+    try
+    {
+      Sum += Lookup(Queries[i]);
+    }
+    catch (const std::exception&)
+    {
+    }
+    Latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Before).count();
+  }
+  std::sort(Latencies.begin(), Latencies.end());
+  auto Percentile = [&](double Fraction) { return Latencies[size_t(Fraction * (Latencies.size() - 1))]; };
+
+  std::cout << Name << "\t" << Queries.size() / Elapsed / 1e6 << " Mq/s\tp50 " << Percentile(0.5) << " ns\tp99 "
+    << Percentile(0.99) << " ns\tp99.9 " << Percentile(0.999) << " ns\tmax " << Latencies.back() << " ns";
+  if (Failed)
+    std::cout << "\t(" << Failed << " out of range)";
+  std::cout << "\t(checksum " << Sum << ")\n";
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: ReplayBench trace.cqry map.txt [engine...]\n";
+    return 2;
+  }
+
+  CQueryTrace Trace;
+  CCalibrationMap Map;
+  try
+  {
+    Trace = CQueryTrace::Load(argv[1]);
+    std::string MapPath = argv[2];
+    if (MapPath.size() > 4 && MapPath.compare(MapPath.size() - 4, 4, ".bin") == 0)
+    {
+      std::ifstream In(MapPath, std::ios::binary);
+      Map = CCalibrationFile::ReadBinary(In);
+    }
+    else
+      Map = CCalibrationFile::LoadText(MapPath);
+  }
+  catch (const std::exception& Error)
+  {
+    std::cerr << Error.what() << "\n";
+    return 2;
+  }
+  if (Trace.Nominals.empty())
+  {
+    std::cerr << "Trace is empty.\n";
+    return 2;
+  }
+
+  std::vector<std::string> Engines(argv + 3, argv + argc);
+  if (Engines.empty())
+    Engines = { "tree", "frozen", "merged", "float", "cached", "linear" };
+
+  auto Start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 1000; ++i)
+    std::chrono::steady_clock::now();
+  double ClockCost = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / 1000;
+  std::cout << Trace.Nominals.size() << " queries over " << Trace.Times.back() / 1e9 << " s captured, "
+    << Map.GetMap().size() << " points, clock overhead " << ClockCost << " ns\n";
+
+  for (size_t e = 0; e < Engines.size(); ++e)
+  {
+    const std::string& Engine = Engines[e];
+    CCalibrationMap Copy = Map;
+    auto Correct = [&Copy](double x) { return Copy.CorrectedPoint(x); };
+    if (Engine == "tree")
+      Replay(Engine, Trace, Correct);
+    else if (Engine == "frozen")
+    {
+      Copy.Freeze();
+      Replay(Engine, Trace, Correct);
+    }
+    else if (Engine == "merged")
+    {
+      CCalibrationMap::FreezeOptions Options;
+      Options.Merge = CCalibrationMap::MergeMode::Tolerance;
+      Options.Tolerance = 1e-9;
+      Copy.Freeze(Options);
+      Replay(Engine, Trace, Correct);
+    }
+    else if (Engine == "float")
+    {
+      CCalibrationMap::FreezeOptions Options;
+      Options.ErrorBudget = 1e-6;
+      Copy.Freeze(Options);
+      Replay(Engine, Trace, Correct);
+    }
+    else if (Engine == "cached")
+    {
+      Copy.Freeze();
+      Copy.EnableCache(4096);
+      Replay(Engine, Trace, Correct);
+      std::cout << "\thit rate " << Copy.GetCacheStats().HitRate() << "\n";
+    }
+    else if (Engine == "linear")
+    {
+      CLinearResidualMap<CHalfFloat> Model;
+      Model.Fit(Map);
+      Replay(Engine, Trace, [&Model](double x) { return Model.CorrectedPoint(x); });
+    }
+    else
+      std::cerr << "Unknown engine " << Engine << "\n";
+  }
+  return 0;
+}
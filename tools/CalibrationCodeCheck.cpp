@@ -0,0 +1,91 @@
+/**
+ * @file CalibrationCodeCheck.cpp
+ * @brief Checks a generated lookup header against CCalibrationMap::ErrorValue().
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -DGENERATED_HEADER='"Generated.h"' -DGENERATED_NAME=CGeneratedCalibration
+ *        CalibrationCodeCheck.cpp -o CalibrationCodeCheck
+ * Usage: CalibrationCodeCheck <calibration file>
+ *
+ * Every breakpoint, every segment midpoint, a seeded set of random nominals and
+ * values just outside the range are compared. Results must be bit-identical and
+ * out-of-range values must be rejected the same way. Exits non-zero on mismatch.
+ */
+
+#include "../CCalibrationFile.h"
+#include GENERATED_HEADER
+#include <iostream>
+#include <random>
+
+/**
+ * @brief Evaluates one lookup, folding the out-of-range cases together.
+ * @param Lookup The lookup to run.
+ * @param Value Receives the error value when in range.
+ * @return False if the lookup threw std::out_of_range or returned NaN.
+ */
+template <typename TLookup>
+static bool Evaluate(TLookup Lookup, double& Value)
+{
+  try
+  {
+    Value = Lookup();
+  }
+  catch (const std::out_of_range&)
+  {
+    return false;
+  }
+  return !std::isnan(Value);
+}
+
+static bool Matches(CCalibrationMap& Map, double Nominal)
+{
+  double Expected = 0.0;
+  double Actual = 0.0;
+  bool ExpectedInRange = Evaluate([&]() { return Map.ErrorValue(Nominal); }, Expected);
+  bool ActualInRange = Evaluate([&]() { return GENERATED_NAME::ErrorValue(Nominal); }, Actual);
+  if (ExpectedInRange != ActualInRange)
+    return false;
+  return !ExpectedInRange || Actual == Expected;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <calibration file>\n";
+    return 2;
+  }
+
+  CCalibrationMap Map = CCalibrationFile::LoadText(argv[1]);
+  const std::map<double, double>& Points = Map.GetMap();
+  if (Points.size() != GENERATED_NAME::Count)
+  {
+    std::cerr << "Generated table has " << GENERATED_NAME::Count << " points, calibration file has " << Points.size() << ".\n";
+    return 1;
+  }
+
+  std::vector<double> Nominals;
+  for (auto it = Points.begin(); it != Points.end(); ++it)
+  {
+    Nominals.push_back(it->first);
+    if (std::next(it) != Points.end())
+      Nominals.push_back(it->first + (std::next(it)->first - it->first) / 2.0);
+  }
+
+  std::mt19937_64 Random(1);
+  std::uniform_real_distribution<double> Uniform(Points.begin()->first, std::prev(Points.end())->first);
+  for (int i = 0; i < 100000; ++i)
+    Nominals.push_back(Uniform(Random));
+  Nominals.push_back(std::nextafter(Points.begin()->first, -INFINITY));
+  Nominals.push_back(std::nextafter(std::prev(Points.end())->first, INFINITY));
+
+  size_t Failures = 0;
+  std::cerr.precision(17);
+  for (size_t i = 0; i < Nominals.size(); ++i)
+  {
+    if (!Matches(Map, Nominals[i]) && ++Failures <= 10)
+      std::cerr << "Mismatch at nominal " << Nominals[i] << "\n";
+  }
+
+  std::cout << Nominals.size() << " nominals checked, " << Failures << " mismatches.\n";
+  return Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file CalibrationCodeGen.cpp
+ * @brief Build-time tool that turns a calibration file into a specialised lookup header.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. CalibrationCodeGen.cpp -o CalibrationCodeGen
+ * Usage: CalibrationCodeGen <calibration file> <output header> [struct name] [--no-exceptions]
+ *
+ * Run CalibrationCodeCheck on the result as part of the same build step.
+ */
+
+#include "../CCalibrationCodeGen.h"
+#include "../CCalibrationFile.h"
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <calibration file> <output header> [struct name] [--no-exceptions]\n";
+    return 2;
+  }
+
+  try
+  {
+    CCalibrationCodeGen::Options Settings;
+    for (int i = 3; i < argc; ++i)
+    {
+      if (std::strcmp(argv[i], "--no-exceptions") == 0)
+        Settings.UseExceptions = false;
+      else
+        Settings.Name = argv[i];
+    }
+
+    CCalibrationMap Map = CCalibrationFile::LoadText(argv[1]);
+    std::ofstream Out(argv[2]);
+    CCalibrationCodeGen::Generate(Out, Map, Settings);
+    if (!Out)
+      throw std::runtime_error(std::string("Unable to write ") + argv[2] + ".");
+  }
+  catch (const std::exception& Error)
+  {
+    std::cerr << Error.what() << "\n";
+    return 1;
+  }
+  return 0;
+}